@@ -0,0 +1,307 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "GOST_28147_89.h"
+
+// Измерение пропускной способности и задержки шифрования ГОСТ 28147-89.
+//
+// Для каждого режима, размера сообщения, способа передачи данных (поток, память,
+// файл через конвейер, через конвейер с прямым вводом-выводом или через отображение в
+// память) и количества потоков выводится время одной операции, скорость и количество
+// тактов на байт. Пример:
+//     gost_benchmark --max-size 1G --threads 1,4,32 --paths memory,file,direct
+
+namespace
+{
+    using Method = GOST_28147_89::Method;
+
+    const char* KEY = "ABCDEFGHIJKLMNOPQRSTUVWXABCDEFGH";
+    const char* IV  = "abcdefgh";
+
+    const std::vector<std::pair<Method, const char*>> METHODS = {
+        { Method::ECB, "ECB" }, { Method::CBC, "CBC" }, { Method::CFB, "CFB" },
+        { Method::OFB, "OFB" }, { Method::CTR, "CTR" },
+    };
+
+    struct Options
+    {
+        size_t max_size = 64ull << 20;
+        std::vector<size_t> threads { 1 };
+        std::vector<std::string> paths { "stream", "memory", "file" };
+        double min_time    = 0.2;
+        std::string kernel = "auto";
+        bool jit           = false;
+    };
+
+    /**
+     * Счетчик тактов процессора (TSC). На платформах без него возвращает 0.
+     */
+    uint64_t readCycles()
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * Разбирает размер вида 4096, 64K, 16M, 1G.
+     */
+    size_t parseSize(const std::string& text)
+    {
+        size_t pos        = 0;
+        const size_t size = std::stoull(text, &pos);
+        switch (pos < text.size() ? text[pos] : '\0') {
+            case 'K':
+            case 'k': return size << 10;
+            case 'M':
+            case 'm': return size << 20;
+            case 'G':
+            case 'g': return size << 30;
+            default: return size;
+        }
+    }
+
+    std::vector<std::string> split(const std::string& text)
+    {
+        std::vector<std::string> items;
+        std::stringstream ss(text);
+        for (std::string item; std::getline(ss, item, ',');)
+            items.push_back(item);
+        return items;
+    }
+
+    std::string formatSize(size_t size)
+    {
+        if (size >= (1ull << 30) && size % (1ull << 30) == 0)
+            return std::to_string(size >> 30) + "G";
+        if (size >= (1ull << 20) && size % (1ull << 20) == 0)
+            return std::to_string(size >> 20) + "M";
+        if (size >= (1ull << 10) && size % (1ull << 10) == 0)
+            return std::to_string(size >> 10) + "K";
+        return std::to_string(size);
+    }
+
+    /**
+     * Минимальная длительность одного измеряемого пакета повторов: время операции
+     * усредняется по пакету, поэтому точность часов и накладные расходы на их чтение
+     * не искажают результат для коротких сообщений.
+     */
+    constexpr double MIN_BATCH_TIME = 0.01;
+
+    /**
+     * Повторяет операцию пакетами, пока суммарное время не превысит min_time, и
+     * выводит усредненные результаты. Размер пакета удваивается, пока пакет не
+     * станет длиннее MIN_BATCH_TIME; более короткие пакеты служат разогревом и не
+     * учитываются.
+     * @param prepare - подготовка перед пакетом из count повторов (не входит в
+     * измерение).
+     * @param run - измеряемая операция; получает номер повтора в пакете.
+     */
+    void measure(const std::string& path, const char* method, size_t size, size_t threads,
+                 double min_time, const std::function<void(size_t count)>& prepare,
+                 const std::function<void(size_t index)>& run)
+    {
+        using clock = std::chrono::steady_clock;
+
+        size_t iterations = 0;
+        double seconds    = 0;
+        uint64_t cycles   = 0;
+        size_t batch      = 1;
+        while (iterations == 0 || seconds < min_time) {
+            prepare(batch);
+            const uint64_t c0 = readCycles();
+            const auto t0     = clock::now();
+            for (size_t i = 0; i < batch; ++i)
+                run(i);
+            const auto t1     = clock::now();
+            const uint64_t c1 = readCycles();
+
+            const double elapsed = std::chrono::duration<double>(t1 - t0).count();
+            if (elapsed < MIN_BATCH_TIME) {
+                batch *= 2;
+                continue;
+            }
+            seconds += elapsed;
+            cycles += c1 - c0;
+            iterations += batch;
+        }
+
+        const double ns_per_op   = seconds * 1e9 / iterations;
+        const double mb_per_sec  = static_cast<double>(size) * iterations / seconds / 1e6;
+        const double cycles_byte = static_cast<double>(cycles) / iterations / size;
+        std::printf("%-7s %-4s %8s %8zu %16.0f %12.2f %12.2f\n", path.c_str(), method,
+                    formatSize(size).c_str(), threads, ns_per_op, mb_per_sec,
+                    cycles_byte);
+        std::fflush(stdout);
+    }
+
+    void benchmarkStream(GOST_28147_89& gost, Method method, const char* name,
+                         const std::string& data, size_t threads, double min_time)
+    {
+        // Каждому повтору пакета нужны свои потоки: их заполнение не измеряется.
+        std::vector<std::istringstream> is;
+        std::vector<std::ostringstream> os;
+        measure(
+            "stream", name, data.size(), threads, min_time,
+            [&](size_t count)
+            {
+                is.resize(count);
+                os.resize(count);
+                for (size_t i = 0; i < count; ++i) {
+                    is[i].str(data);
+                    is[i].clear();
+                    os[i].str({});
+                }
+            },
+            [&](size_t i) { gost.encrypt(method, is[i], os[i]); });
+    }
+
+    void benchmarkMemory(GOST_28147_89& gost, Method method, const char* name,
+                         const std::string& data, std::vector<std::byte>& output,
+                         size_t threads, double min_time)
+    {
+        const auto input = std::as_bytes(std::span(data));
+        measure(
+            "memory", name, data.size(), threads, min_time, [](size_t) {},
+            [&](size_t) { gost.encrypt(method, input, output); });
+    }
+
+    const std::vector<std::pair<std::string, GOST_28147_89::FileIo>> FILE_PATHS = {
+        { "file", GOST_28147_89::FileIo::Pipeline },
+        { "direct", GOST_28147_89::FileIo::DirectPipeline },
+        { "mmap", GOST_28147_89::FileIo::Mapped },
+    };
+
+    void benchmarkFile(GOST_28147_89& gost, const std::string& path,
+                       GOST_28147_89::FileIo file_io, const std::string& data,
+                       size_t threads, double min_time)
+    {
+        // Файловые функции всегда используют режим CTR.
+        const auto dir          = std::filesystem::temp_directory_path();
+        const std::string input = (dir / "gost_benchmark_input.bin").string();
+        const std::string output =
+            (dir / "gost_benchmark_input_encrypted.bin").string();
+        {
+            std::ofstream file(input, std::ios::binary);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        gost.setFileIo(file_io);
+        measure(
+            path, "CTR", data.size(), threads, min_time, [](size_t) {},
+            [&](size_t) { gost.encryptFile(input, output); });
+        std::filesystem::remove(input);
+        std::filesystem::remove(output);
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool has_value  = i + 1 < argc;
+            if (arg == "--max-size" && has_value) {
+                options.max_size = parseSize(argv[++i]);
+            } else if (arg == "--threads" && has_value) {
+                options.threads.clear();
+                for (const auto& item : split(argv[++i]))
+                    options.threads.push_back(std::stoul(item));
+            } else if (arg == "--paths" && has_value) {
+                options.paths = split(argv[++i]);
+            } else if (arg == "--min-time" && has_value) {
+                options.min_time = std::stod(argv[++i]);
+            } else if (arg == "--kernel" && has_value) {
+                options.kernel = argv[++i];
+            } else if (arg == "--jit") {
+                options.jit = true;
+            } else {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--max-size 1G] [--threads 1,4,32]"
+                             " [--paths stream,memory,file,direct,mmap]"
+                             " [--min-time 0.2]"
+                             " [--kernel auto|avx512|avx2|interleaved|scalar] [--jit]"
+                          << std::endl;
+                std::exit(arg == "--help" ? 0 : 1);
+            }
+        }
+        return options;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Options options = parseOptions(argc, argv);
+    if (!GOST_28147_89::setKernel(options.kernel)) {
+        std::cerr << "Kernel " << options.kernel << " is not available." << std::endl;
+        return 1;
+    }
+    std::printf("kernel: %s\n", GOST_28147_89::kernel().c_str());
+
+    // Размеры сообщений: 8 байт, затем каждый следующий в 8 раз больше, до max_size.
+    std::vector<size_t> sizes;
+    for (size_t size = 8; size <= options.max_size; size *= 8)
+        sizes.push_back(size);
+    if (sizes.empty() || sizes.back() != options.max_size)
+        sizes.push_back(options.max_size);
+
+    std::string data(options.max_size, '\0');
+    uint32_t seed = 12345;
+    for (auto& c : data) {
+        seed = seed * 1103515245 + 12345;
+        c    = static_cast<char>(seed >> 16);
+    }
+    std::vector<std::byte> output(GOST_28147_89::outputSize(options.max_size));
+
+    std::printf("%-7s %-4s %8s %8s %16s %12s %12s\n", "path", "mode", "size", "threads",
+                "ns/op", "MB/s", "cycles/byte");
+
+    for (const size_t threads : options.threads) {
+        GOST_28147_89 gost(KEY);
+        gost.setInitializationVector(IV);
+        gost.setThreadCount(threads);
+        if (options.jit && !gost.setJit(true)) {
+            std::cerr << "JIT is not available." << std::endl;
+            return 1;
+        }
+
+        for (const size_t size : sizes) {
+            const std::string message = data.substr(0, size);
+            for (const auto& path : options.paths) {
+                const auto file_path = std::find_if(FILE_PATHS.begin(), FILE_PATHS.end(),
+                                                    [&](const auto& item)
+                                                    { return item.first == path; });
+                if (file_path != FILE_PATHS.end()) {
+                    benchmarkFile(gost, path, file_path->second, message, threads,
+                                  options.min_time);
+                    continue;
+                }
+                for (const auto& [method, name] : METHODS) {
+                    if (path == "stream")
+                        benchmarkStream(gost, method, name, message, threads,
+                                        options.min_time);
+                    else if (path == "memory")
+                        benchmarkMemory(gost, method, name, message, output, threads,
+                                        options.min_time);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,16 +1,12 @@
-﻿#include <cassert>
-#include <iomanip>
+﻿#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
 #include <string>
 
 #include "GOST_28147_89.h"
-
-std::ostream& operator<<(std::ostream& os, const GOST_28147_89::block_t& block)
-{
-    for (const auto& byte : block)
-        os << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte)
-           << ' ';
-    return os;
-}
+#include "ThreadPool.h"
 
 // 1. Разобьем ключ на 8 блоков по 4 символа
 //     A B C D | E F G H | I J K L | M N O P | Q R S T | U V W X | A B C D | E F G H
@@ -22,33 +18,73 @@ std::ostream& operator<<(std::ostream& os, const GOST_28147_89::block_t& block)
 // 5. Получим итоговый результат
 //     0x41424344 0x45464748 0x494A4B4C 0x4D4E4F50 0x51525354 0x55565758 0x41424344
 //     0x45464748
-GOST_28147_89::GOST_28147_89(const char* key)
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::GOST_28147_89_Basic(const char* key)
+{
+    rekey(key);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::GOST_28147_89_Basic(std::span<const std::byte, 32> key)
+{
+    rekey(key);
+}
+
+template <typename ParamSet>
+bool GOST_28147_89_Basic<ParamSet>::setJit(bool enable)
+{
+    return enableJit(enable ? &m_round_tables : nullptr);
+}
+
+GOST_28147_89_Common::~GOST_28147_89_Common()
+{
+    secureWipe(m_key.data(), sizeof(m_key));
+    secureWipe(m_encrypt_schedule.data(), sizeof(m_encrypt_schedule));
+    secureWipe(m_decrypt_schedule.data(), sizeof(m_decrypt_schedule));
+}
+
+void GOST_28147_89_Common::secureWipe(void* data, size_t size)
+{
+    // Запись через volatile-указатель компилятор обязан выполнить.
+    volatile byte_t* p = static_cast<volatile byte_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+        p[i] = 0;
+}
+
+void GOST_28147_89_Common::rekey(const char* key)
 {
     // Выбрасываем исключение если длина ключа не соответсвует 32 байтам.
     assert(strlen(key) == 32 && "Key must be 32 bytes long.");
 
-#ifdef PR_DEBUG
-    std::cout << "[ Cipher key ]: ";
-#endif // DEBUG
-    for (size_t i = 0; i < 8; ++i) {
-        m_key[i] =
-            static_cast<uint32_t>(static_cast<unsigned char>(key[4 * i]) << 24)
-            | static_cast<uint32_t>(static_cast<unsigned char>(key[4 * i + 1]) << 16)
-            | static_cast<uint32_t>(static_cast<unsigned char>(key[4 * i + 2]) << 8)
-            | static_cast<uint32_t>(static_cast<unsigned char>(key[4 * i + 3]));
-
-#ifdef PR_DEBUG
-        std::cout << std::hex << std::uppercase << std::setw(8) << std::setfill('0')
-                  << m_key[i] << " ";
-#endif // DEBUG
+    rekey(std::span<const std::byte, 32>(reinterpret_cast<const std::byte*>(key), 32));
+}
+
+void GOST_28147_89_Common::rekey(std::span<const std::byte, 32> key)
+{
+    for (size_t i = 0; i < 8; ++i)
+        m_key[i] = static_cast<uint32_t>(key[4 * i]) << 24
+                   | static_cast<uint32_t>(key[4 * i + 1]) << 16
+                   | static_cast<uint32_t>(key[4 * i + 2]) << 8
+                   | static_cast<uint32_t>(key[4 * i + 3]);
+
+    // Разворачиваем ключ в последовательности раундовых ключей.
+    // Зашифрование:
+    //     Раунды 1 - 24 : key[0]->key[7] (три раза)
+    //     Раунды 25 - 32 : key[7]->key[0]
+    // Расшифрование выполняется в обратном порядке:
+    //     Раунды 1 - 8 : key[0]->key[7]
+    //     Раунды 9 - 32 : key[7]->key[0] (три раза)
+    for (size_t i = 0; i < 32; ++i) {
+        m_encrypt_schedule[i] = m_key[i < 24 ? i % 8 : 31 - i];
+        m_decrypt_schedule[i] = m_key[i < 8 ? i : 7 - i % 8];
     }
 
-#ifdef PR_DEBUG
-    std::cout << std::endl << std::endl;
-#endif // DEBUG
+    // Сгенерированный код содержит прежние раундовые ключи.
+    if (m_jit_tables)
+        enableJit(m_jit_tables);
 }
 
-void GOST_28147_89::setInitializationVector(const char* iv)
+void GOST_28147_89_Common::setInitializationVector(const char* iv)
 {
     assert(strlen(iv) == 8 && "Initialization vector must be exactly 8 bytes long.");
 
@@ -56,109 +92,150 @@ void GOST_28147_89::setInitializationVector(const char* iv)
         m_initialization_vector[i] = static_cast<byte_t>(iv[i]);
 }
 
-uint32_t GOST_28147_89::f(const std::array<byte_t, 4>& A, const uint32_t& key)
-{
-    // Константа (2^32). C ее помощью числа приводится к 32-битам.
-    static const uint64_t MODULO = 1ull << 32;
-    uint64_t A_bits              = (blockToBits<uint32_t>(A) + key) % MODULO;
-
-    /**
-     * Цикл выполняет операцию подстановки (замены) на 4-битных блоках числа A_bits,
-     * используя таблицы замен m_s_blocks.
-     *
-     * Например, если A_bits = 0xB0EE439B, то i = 0:
-     * - Извлекаем 4 бита из A_bits на позиции 0 (самые правые 4 бита). Получаем 0xB.
-     * - Используем это значение как индекс в первой таблице замен. Получаем
-     * m_s_blocks[0][0xB] = 0xC.
-     * - Присваиваем значение four_bit_blocks[7] (т.е. первому с конца элементу) значение
-     * 0xC.
-     *
-     * Повторяем эти действия для каждого 4-битного блока A_bits.
-     */
-    block_t four_bit_blocks = { 0, 0, 0, 0, 0, 0, 0, 0 };
-    for (size_t i = 0; i < 8; ++i)
-        four_bit_blocks[7 - i] = m_s_blocks.at(i).at(extract4Bits(A_bits, i));
-
-    // Преобразование блока обратно в 32ое число.
-    uint32_t res = blockToBits<uint32_t>(four_bit_blocks);
-    // Выполнение циклического сдвига на 11 позиций влево.
-    return ((res << 11) | (res >> 21));
+template <typename ParamSet>
+inline uint32_t GOST_28147_89_Basic<ParamSet>::f(const uint32_t A,
+                                                 const uint32_t key) const
+{
+    // Сложение по модулю 2^32 выполняется естественным переполнением uint32_t.
+    const uint32_t x = A + key;
+    return m_round_tables[0][x & 0xFF] ^ m_round_tables[1][(x >> 8) & 0xFF]
+           ^ m_round_tables[2][(x >> 16) & 0xFF] ^ m_round_tables[3][x >> 24];
 }
 
-GOST_28147_89::block_t GOST_28147_89::block_cipher(const std::array<uint32_t, 8>& __key,
-                                                   const block_t& text_block)
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::block_cipher(const round_keys_t& schedule,
+                                            const block_t& text_block) const
 {
     // [ INPUT BLOCK ]: 48 65 6C 6C 6F 2C 20 57
-#ifdef PR_DEBUG
-    std::cout << std::setfill('-') << std::setw(50) << "\n";
-    std::cout << "[ KEY ]\t\t: ";
-    for (const auto& b : __key)
-        std::cout << b << " ";
-    std::cout << std::endl;
-    std::cout << "[ INPUT BLOCK ]\t: " << text_block << std::endl;
-#endif
-
-    // Начальное разделение 8-байтного блока на две 4-байтные части.
+    // Начальное разделение 8-байтного блока на две 32-битные части.
     // B: 0x48656C6C (ASCII представление "Hell")
     // A: 0x6F2C2057 (ASCII представление "o, W")
-    std::array<byte_t, 4> B = {
-        text_block[0],
-        text_block[1],
-        text_block[2],
-        text_block[3],
-    };
-    std::array<byte_t, 4> A = {
-        text_block[4],
-        text_block[5],
-        text_block[6],
-        text_block[7],
-    };
-
-    // 32 раунда шифрования, основанные на сети Фейстеля
-    for (size_t key, i = 0; i < 32; ++i) {
-        // Определяем текущий ключ для раунда
-        // Раунды 1 - 8 : key[0]->key[7]
-        // Раунды 9 - 16 : key[0]->key[7]
-        // Раунды 17 - 24 : key[0]->key[7]
-        // Раунды 25 - 32 : key[7]->key[0]
-        // При обратном ключе (для CBC) делаем все наоборот
-        key = (m_key == __key) ? __key.at(i < 24 ? i % 8 : 31 - i)
-                               : __key.at(i < 8 ? 7 - i : i % 8);
+    const uint64_t bits = blockToBits<uint64_t>(text_block);
+    uint32_t B          = static_cast<uint32_t>(bits >> 32);
+    uint32_t A          = static_cast<uint32_t>(bits);
 
+    // 32 раунда шифрования, основанные на сети Фейстеля. Порядок раундовых ключей
+    // определяется переданной последовательностью (см. rekey).
+    for (size_t i = 0; i < 32; ++i) {
         // Применение операции XOR к блоку B и результату функции f, примененной к блоку A
-        // и текущему ключу
-        uint32_t B_bits = blockToBits<uint32_t>(B) ^ f(A, key);
-
-        /// Перемещаем значение из A в B и из B_bits в A для следующего раунда.
-        B = A;
-        A = bitsToBlock<uint32_t, A.size()>(B_bits);
+        // и текущему ключу. Затем перемещаем значение из A в B и из B_bits в A для
+        // следующего раунда.
+        const uint32_t B_bits = B ^ f(A, schedule[i]);
+        B                     = A;
+        A                     = B_bits;
     }
 
-    block_t output = {
-        A[0], A[1], A[2], A[3], B[0], B[1], B[2], B[3],
-    };
-#ifdef PR_DEBUG
-    std::cout << "[ OUT BLOCK ]\t: " << output << std::endl;
-    std::cout << std::setfill('-') << std::setw(50) << "\n";
-#endif
-    return output;
+    return bitsToBlock<uint64_t, 8>(static_cast<uint64_t>(A) << 32 | B);
 };
 
-std::string GOST_28147_89::processStream(Method method,
-                                         const std::array<uint32_t, 8>& key,
-                                         bool isEncrypt)
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::block_cipher_multi(const round_keys_t& schedule,
+                                                       const byte_t* in, byte_t* out,
+                                                       size_t count) const
+{
+    const size_t done = runJit(schedule, in, out, count);
+    runKernels(m_round_tables, schedule, in + done * 8, out + done * 8, count - done);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::mac_cycle(const block_t& text_block) const
+{
+    const uint64_t bits = blockToBits<uint64_t>(text_block);
+    uint32_t B          = static_cast<uint32_t>(bits >> 32);
+    uint32_t A          = static_cast<uint32_t>(bits);
+
+    // Первые 16 раундовых ключей последовательности зашифрования: k0..k7 дважды.
+    for (size_t i = 0; i < 16; ++i) {
+        const uint32_t B_bits = B ^ f(A, m_encrypt_schedule[i]);
+        B                     = A;
+        A                     = B_bits;
+    }
+
+    // В отличие от block_cipher, результат последнего раунда не переставляется.
+    return bitsToBlock<uint64_t, 8>(static_cast<uint64_t>(B) << 32 | A);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::updateMac(MacState& mac, const byte_t* data,
+                                              size_t count) const
+{
+    // Каждый блок складывается по модулю 2 с текущим значением имитовставки и
+    // преобразуется циклом 16-З. Начальное значение - нулевой блок.
+    block_t block;
+    for (size_t i = 0; i < count; ++i, data += block.size()) {
+        std::memcpy(block.data(), data, block.size());
+        mac.value = mac_cycle(mac.value ^ block);
+    }
+    mac.count += count;
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t GOST_28147_89_Basic<ParamSet>::finalMac(MacState& mac) const
 {
-    std::string result;
-    block_t block, prev, xored, temp;
+    if (mac.count == 1) {
+        const block_t zero = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        updateMac(mac, zero.data(), 1);
+    }
+    return mac.value;
+}
 
-    prev = m_initialization_vector;
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processBlocks(Method method, bool isEncrypt,
+                                                  const byte_t* in, byte_t* out,
+                                                  size_t count, block_t& prev) const
+{
+    block_t block, xored, temp;
+
+    const round_keys_t& usedKey = isEncrypt ? m_encrypt_schedule : m_decrypt_schedule;
 
-    std::array<uint32_t, 8> usedKey =
-        isEncrypt ? key : std::array<uint32_t, 8> { key[7], key[6], key[5], key[4],
-                                                    key[3], key[2], key[1], key[0] };
     // ECB (Electronic Codebook) Mode:
-    // Просто шифрует или дешифрует каждый блок данных независимо.
-    auto handleECB = [&]() { return block_cipher(usedKey, block); };
+    // Просто шифрует или дешифрует каждый блок данных независимо, поэтому вся порция
+    // передается многоблочному ядру.
+    if (method == Method::ECB) {
+        block_cipher_multi(usedKey, in, out, count);
+        return;
+    }
+
+    // CTR (Counter) Mode:
+    // В этом режиме каждый блок данных XOR-ится с зашифрованным значением счетчика.
+    // Счетчик обычно начинается с определенного значения и инкрементируется на единицу
+    // с каждым новым блоком данных. Значения счетчика формируются группами во
+    // временном буфере, шифруются многоблочным ядром и накладываются на данные.
+    if (method == Method::CTR) {
+        constexpr size_t GAMMA_BLOCKS = 64;
+        std::array<byte_t, GAMMA_BLOCKS * sizeof(block_t)> gamma;
+
+        uint64_t counter = blockToBits<uint64_t>(prev);
+
+        // Сгенерированный для ключа код (см. setJit) сам формирует значения счетчика.
+        const size_t done = runJitCounter(counter, in, out, count);
+        in += done * block.size();
+        out += done * block.size();
+        count -= done;
+        counter += done;
+
+        while (count > 0) {
+            const size_t n = std::min(count, GAMMA_BLOCKS);
+            for (size_t i = 0; i < n; ++i, ++counter) {
+                // Следующее значение счетчика не помещается в 64 бита.
+                if (counter == UINT64_MAX)
+                    throw std::runtime_error("Counter overflow detected");
+                block = bitsToBlock<uint64_t, 8>(counter);
+                std::memcpy(gamma.data() + i * block.size(), block.data(), block.size());
+            }
+            block_cipher_multi(m_encrypt_schedule, gamma.data(), gamma.data(), n);
+            for (size_t i = 0; i < n * block.size(); ++i)
+                out[i] = in[i] ^ gamma[i];
+
+            in += n * block.size();
+            out += n * block.size();
+            count -= n;
+        }
+        prev = bitsToBlock<uint64_t, 8>(counter);
+        return;
+    }
 
     // CBC (Cipher Block Chaining) Mode:
     // Каждый блок данных перед шифрованием XOR-ится с предыдущим блоком зашифрованных
@@ -183,7 +260,7 @@ std::string GOST_28147_89::processStream(Method method,
     // открытого текста.
     auto handleCFB = [&]()
     {
-        xored = block ^ block_cipher(m_key, prev);
+        xored = block ^ block_cipher(m_encrypt_schedule, prev);
         prev  = isEncrypt ? xored : block;
         return xored;
     };
@@ -192,51 +269,623 @@ std::string GOST_28147_89::processStream(Method method,
     // Блок данных XOR-ится с зашифрованным значением предыдущего блока.
     auto handleOFB = [&]()
     {
-        prev = block_cipher(m_key, prev);
+        prev = block_cipher(m_encrypt_schedule, prev);
         return block ^ prev;
     };
 
-    // CTR (Counter) Mode:
-    // В этом режиме каждый блок данных XOR-ится с зашифрованным значением счетчика.
-    // Счетчик обычно начинается с определенного значения и инкрементируется на единицу
-    // с каждым новым блоком данных.
-    auto handleCTR = [&]()
-    {
-        block_t counter_encrypted = block_cipher(m_key, prev);
-        prev                      = incrementCounter(prev);
-        return block ^ counter_encrypted;
-    };
-
-#ifdef PR_DEBUG
-    (isEncrypt) ? std::cout << "\n\t\t[ ENCRYPTED ]\n"
-                            << std::endl
-                : std::cout << "\n\t\t[ DECRYPTED ]\n"
-                            << std::endl;
-    std::cout << std::setfill('=') << std::setw(50) << "\n";
-#endif
-    // Последовательно разбиваем входной поток на блоки данных по 8 байт и
-    // обрабатываем их, пока он не закончится.
-    while (!m_stream->eof()) {
-        block = read_block();
+    for (size_t i = 0; i < count; ++i, in += block.size(), out += block.size()) {
+        std::memcpy(block.data(), in, block.size());
         switch (method) {
-            case Method::ECB: block = handleECB(); break;
             case Method::CBC: block = handleCBC(); break;
             case Method::CFB: block = handleCFB(); break;
             case Method::OFB: block = handleOFB(); break;
-            case Method::CTR: block = handleCTR(); break;
             default: break;
         }
-        result += blockToString(block);
+        std::memcpy(out, block.data(), block.size());
+    }
+}
+
+bool GOST_28147_89_Common::isParallelizable(Method method, bool isEncrypt)
+{
+    // В режимах ECB и CTR блоки независимы. При расшифровании в режимах CBC и CFB
+    // каждому блоку нужен только предыдущий блок шифротекста, который уже известен.
+    switch (method) {
+        case Method::ECB:
+        case Method::CTR: return true;
+        case Method::CBC:
+        case Method::CFB: return !isEncrypt;
+        default: return false;
+    }
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processChunk(Method method, bool isEncrypt,
+                                                 const byte_t* in, byte_t* out,
+                                                 size_t count, block_t& prev) const
+{
+    constexpr size_t BLOCK_SIZE = sizeof(block_t);
+
+    const size_t tasks = (m_pool && isParallelizable(method, isEncrypt))
+                             ? std::min(m_pool->size(), count / MIN_BLOCKS_PER_TASK)
+                             : 1;
+    if (tasks <= 1) {
+        processBlocks(method, isEncrypt, in, out, count, prev);
+        return;
+    }
+
+    // Разбиваем порцию на участки и заранее вычисляем начальное состояние каждого из
+    // них: при обработке на месте (in == out) блоки шифротекста перезаписываются,
+    // поэтому их нужно сохранить до начала обработки.
+    std::vector<block_t> states(tasks);
+    auto begin = [&](size_t task) { return count * task / tasks; };
+    for (size_t task = 0; task < tasks; ++task) {
+        const size_t first = begin(task);
+        if (method == Method::CTR)
+            states[task] = advanceCounter(prev, first);
+        else if (first == 0)
+            states[task] = prev;
+        else
+            std::memcpy(states[task].data(), in + (first - 1) * BLOCK_SIZE, BLOCK_SIZE);
+    }
+
+    block_t next = prev;
+    if (method == Method::CTR)
+        next = advanceCounter(prev, count);
+    else if (method != Method::ECB)
+        std::memcpy(next.data(), in + (count - 1) * BLOCK_SIZE, BLOCK_SIZE);
+
+    m_pool->parallelFor(tasks,
+                        [&](size_t task)
+                        {
+                            const size_t first = begin(task);
+                            processBlocks(method, isEncrypt, in + first * BLOCK_SIZE,
+                                          out + first * BLOCK_SIZE,
+                                          begin(task + 1) - first, states[task]);
+                        });
+    prev = next;
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processStream(Method method, const block_t& iv,
+                                                  std::istream& is, std::ostream& os,
+                                                  bool isEncrypt, MacState* mac) const
+{
+    CallStatistics statistics(method);
+    block_t prev = iv;
+
+    // Читаем входной поток порциями фиксированного размера (processingChunkSize),
+    // разбиваем каждую порцию на блоки данных по 8 байт, обрабатываем их на месте и
+    // сразу записываем в выходной поток. Объем используемой памяти не зависит от
+    // размера входных данных.
+    std::vector<byte_t> buffer(processingChunkSize());
+    bool processed = false;
+    while (is) {
+        is.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<std::streamsize>(buffer.size()));
+        const size_t count = static_cast<size_t>(is.gcount());
+        if (count == 0 && processed)
+            break;
+
+        // Последний неполный блок дополняется нулями. Пустой поток, как и прежде,
+        // превращается в один нулевой блок.
+        const size_t padded = outputSize(count);
+        std::fill(buffer.begin() + count, buffer.begin() + padded, 0);
+
+        // Имитовставка вырабатывается по открытому тексту: до зашифрования или после
+        // расшифрования порции, пока она находится в кэше.
+        if (mac && isEncrypt)
+            updateMac(*mac, buffer.data(), padded / 8);
+        processChunk(method, isEncrypt, buffer.data(), buffer.data(), padded / 8, prev);
+        if (mac && !isEncrypt)
+            updateMac(*mac, buffer.data(), padded / 8);
+        os.write(reinterpret_cast<const char*>(buffer.data()),
+                 static_cast<std::streamsize>(padded));
+        statistics.add(count, padded / 8);
+        processed = true;
+    }
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::processBuffer(Method method, const block_t& iv,
+                                                    std::span<const std::byte> input,
+                                                    std::span<std::byte> output,
+                                                    bool isEncrypt, MacState* mac) const
+{
+    const size_t size = outputSize(input.size());
+    if (output.size() < size)
+        throw std::length_error("Output buffer is too small.");
+
+    CallStatistics statistics(method);
+    statistics.add(input.size(), size / 8);
+    const byte_t* in = reinterpret_cast<const byte_t*>(input.data());
+    byte_t* out      = reinterpret_cast<byte_t*>(output.data());
+
+    // Полные блоки обрабатываются напрямую, последний неполный блок дополняется нулями
+    // во временном блоке, так как за концом входных данных читать нельзя.
+    block_t prev = iv;
+    auto process = [&](const byte_t* from, byte_t* to, size_t count)
+    {
+        if (mac && isEncrypt)
+            updateMac(*mac, from, count);
+        processChunk(method, isEncrypt, from, to, count, prev);
+        if (mac && !isEncrypt)
+            updateMac(*mac, to, count);
+    };
+
+    // При выработке имитовставки данные обрабатываются порциями processingChunkSize,
+    // чтобы каждая порция читалась из памяти один раз (см. processStream).
+    const size_t full = input.size() / 8;
+    const size_t step = mac ? processingChunkSize() / 8 : full;
+    for (size_t done = 0; done < full; done += step) {
+        const size_t count = std::min(step, full - done);
+        process(in + done * 8, out + done * 8, count);
+    }
+    if (size > full * 8) {
+        block_t block = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        std::memcpy(block.data(), in + full * 8, input.size() - full * 8);
+        process(block.data(), out + full * 8, 1);
+    }
+    return size;
+}
+
+template <typename ParamSet>
+size_t
+GOST_28147_89_Basic<ParamSet>::processCounterRange(uint64_t offset,
+                                                   std::span<const std::byte> input,
+                                                   std::span<std::byte> output) const
+{
+    return processCounterRange(m_initialization_vector, offset, input, output);
+}
+
+template <typename ParamSet>
+size_t
+GOST_28147_89_Basic<ParamSet>::processCounterRange(const block_t& iv, uint64_t offset,
+                                                   std::span<const std::byte> input,
+                                                   std::span<std::byte> output) const
+{
+    if (output.size() < input.size())
+        throw std::length_error("Output buffer is too small.");
+
+    CallStatistics statistics(Method::CTR);
+    statistics.add(input.size(), (offset % 8 + input.size() + 7) / 8);
+    const byte_t* in = reinterpret_cast<const byte_t*>(input.data());
+    byte_t* out      = reinterpret_cast<byte_t*>(output.data());
+    size_t size      = input.size();
+
+    // Счетчик блока с номером offset / 8 равен вектору инициализации плюс номер.
+    block_t counter    = advanceCounter(iv, offset / 8);
+    const size_t skip  = static_cast<size_t>(offset % 8);
+    const size_t first = skip == 0 ? 0 : std::min(size, 8 - skip);
+
+    // Неполные блоки в начале и в конце диапазона обрабатываются во временном блоке:
+    // гамма вычисляется для всего блока, а используется только нужная ее часть.
+    auto partial = [&](size_t from, size_t length)
+    {
+        block_t block = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        std::memcpy(block.data() + from, in, length);
+        processBlocks(Method::CTR, true, block.data(), block.data(), 1, counter);
+        std::memcpy(out, block.data() + from, length);
+        in += length;
+        out += length;
+        size -= length;
+    };
+
+    if (first > 0)
+        partial(skip, first);
+    const size_t full = size / 8;
+    processChunk(Method::CTR, true, in, out, full, counter);
+    in += full * 8;
+    out += full * 8;
+    size -= full * 8;
+    if (size > 0)
+        partial(0, size);
+    return input.size();
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processBatch(Method method, bool isEncrypt,
+                                                 std::span<const Message> messages) const
+{
+    for (const Message& message : messages)
+        if (message.output.size() < outputSize(message.input.size()))
+            throw std::length_error("Output buffer is too small.");
+
+    CallStatistics statistics(method);
+    for (const Message& message : messages)
+        statistics.add(message.input.size(), outputSize(message.input.size()) / 8);
+
+    // Сообщения независимы, поэтому пакет делится между потоками на равные части.
+    const size_t tasks =
+        m_pool ? std::min(m_pool->size(), messages.size() / BATCH_LANES) : 0;
+    if (tasks < 2) {
+        processLanes(method, isEncrypt, messages);
+        return;
+    }
+    const size_t per_task = (messages.size() + tasks - 1) / tasks;
+    m_pool->parallelFor(tasks,
+                        [&](size_t task)
+                        {
+                            const size_t first = task * per_task;
+                            const size_t count =
+                                std::min(per_task, messages.size() - first);
+                            processLanes(method, isEncrypt,
+                                         messages.subspan(first, count));
+                        });
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processLanes(Method method, bool isEncrypt,
+                                                 std::span<const Message> messages) const
+{
+    const round_keys_t& schedule =
+        (method == Method::ECB || method == Method::CBC) && !isEncrypt
+            ? m_decrypt_schedule
+            : m_encrypt_schedule;
+
+    // Дорожка - обрабатываемое сообщение: позиция следующего блока, состояние
+    // сцепления и текущий входной блок (сохраняется, так как output может совпадать
+    // с input).
+    struct Lane
+    {
+        const Message* message;
+        size_t position;
+        block_t prev;
+        block_t in;
+    };
+    std::array<Lane, BATCH_LANES> lanes;
+    std::array<byte_t, BATCH_LANES * sizeof(block_t)> buffer;
+    size_t active = 0;
+    size_t next   = 0;
+
+    for (;;) {
+        // Освободившиеся дорожки занимают следующие сообщения.
+        for (; active < BATCH_LANES && next < messages.size(); ++active, ++next)
+            lanes[active] = { &messages[next], 0, messages[next].iv, {} };
+        if (active == 0)
+            break;
+
+        // Собираем входы шифра для очередного блока каждого сообщения. Последний
+        // неполный блок дополняется нулями, пустое сообщение - один нулевой блок.
+        for (size_t i = 0; i < active; ++i) {
+            Lane& lane       = lanes[i];
+            const auto input = lane.message->input;
+            const size_t n   = std::min<size_t>(8, input.size() - lane.position);
+            lane.in          = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            std::memcpy(lane.in.data(), input.data() + lane.position, n);
+
+            block_t x;
+            switch (method) {
+                case Method::ECB: x = lane.in; break;
+                case Method::CBC: x = isEncrypt ? lane.in ^ lane.prev : lane.in; break;
+                case Method::CTR:
+                    // Следующее значение счетчика не помещается в 64 бита.
+                    if (blockToBits<uint64_t>(lane.prev) == UINT64_MAX)
+                        throw std::runtime_error("Counter overflow detected");
+                    x = lane.prev;
+                    break;
+                default: x = lane.prev; break;
+            }
+            std::memcpy(buffer.data() + i * x.size(), x.data(), x.size());
+        }
+
+        block_cipher_multi(schedule, buffer.data(), buffer.data(), active);
+
+        // Раскладываем результаты по сообщениям и обновляем состояние сцепления.
+        for (size_t i = 0; i < active; ++i) {
+            Lane& lane = lanes[i];
+            block_t y, out;
+            std::memcpy(y.data(), buffer.data() + i * y.size(), y.size());
+            switch (method) {
+                case Method::ECB: out = y; break;
+                case Method::CBC:
+                    out       = isEncrypt ? y : y ^ lane.prev;
+                    lane.prev = isEncrypt ? y : lane.in;
+                    break;
+                case Method::CFB:
+                    out       = lane.in ^ y;
+                    lane.prev = isEncrypt ? out : lane.in;
+                    break;
+                case Method::OFB:
+                    out       = lane.in ^ y;
+                    lane.prev = y;
+                    break;
+                case Method::CTR:
+                    out       = lane.in ^ y;
+                    lane.prev = advanceCounter(lane.prev, 1);
+                    break;
+            }
+            std::memcpy(lane.message->output.data() + lane.position, out.data(),
+                        out.size());
+            lane.position += out.size();
+        }
+
+        // Завершенные сообщения освобождают дорожки.
+        for (size_t i = 0; i < active;) {
+            if (lanes[i].position >= lanes[i].message->input.size())
+                lanes[i] = lanes[--active];
+            else
+                ++i;
+        }
     }
-#ifdef PR_DEBUG
-    std::cout << std::setfill('=') << std::setw(50) << "\n";
-#endif
-    return result;
 }
 
-std::string GOST_28147_89::generateOutputFilename(const std::string& input_filename,
-                                                  const std::string& suffix,
-                                                  const std::string& default_suffix) const
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::Context::Context(const GOST_28147_89_Basic& cipher,
+                                                Method method, bool isEncrypting)
+    : m_cipher(cipher)
+    , m_method(method)
+    , m_encrypt(isEncrypting)
+    , m_prev(cipher.m_initialization_vector)
+{
+}
+
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::Context::Context(const GOST_28147_89_Basic& cipher,
+                                                Method method, bool isEncrypting,
+                                                const block_t& iv)
+    : m_cipher(cipher)
+    , m_method(method)
+    , m_encrypt(isEncrypting)
+    , m_prev(iv)
+{
+}
+
+template <typename ParamSet>
+bool GOST_28147_89_Basic<ParamSet>::Context::isStreamMode() const
+{
+    return m_method == Method::CFB || m_method == Method::OFB || m_method == Method::CTR;
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::Context::nextGamma()
+{
+    const round_keys_t& schedule = m_cipher.m_encrypt_schedule;
+    switch (m_method) {
+        // В режиме CFB следующее состояние - блок шифротекста, который станет
+        // известен только после получения всего блока (см. update).
+        case Method::CFB: m_gamma = m_cipher.block_cipher(schedule, m_prev); break;
+        case Method::OFB:
+            m_prev  = m_cipher.block_cipher(schedule, m_prev);
+            m_gamma = m_prev;
+            break;
+        case Method::CTR:
+            m_gamma = m_cipher.block_cipher(schedule, m_prev);
+            m_prev  = m_cipher.advanceCounter(m_prev, 1);
+            break;
+        default: break;
+    }
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::Context::update(std::span<const std::byte> input,
+                                                      std::span<std::byte> output)
+{
+    const bool stream     = isStreamMode();
+    const size_t required = stream ? input.size() : (m_position + input.size()) / 8 * 8;
+    if (output.size() < required)
+        throw std::length_error("Output buffer is too small.");
+
+    // Учитываются блоки, начатые этим вызовом (в режимах ECB и CBC - выданные).
+    CallStatistics statistics(m_method);
+    statistics.add(input.size(), stream ? (m_position + input.size() + 7) / 8
+                                              - (m_position + 7) / 8
+                                        : required / 8);
+
+    const byte_t* in = reinterpret_cast<const byte_t*>(input.data());
+    byte_t* out      = reinterpret_cast<byte_t*>(output.data());
+    size_t size      = input.size();
+    size_t written   = 0;
+    if (size != 0)
+        m_empty = false;
+
+    // 1. Дополняем начатый ранее неполный блок.
+    while (m_position != 0 && size != 0) {
+        if (stream) {
+            const byte_t c = *in ^ m_gamma[m_position];
+            m_block[m_position] = m_encrypt ? c : *in;
+            out[written++]      = c;
+        } else {
+            m_block[m_position] = *in;
+        }
+        ++in;
+        --size;
+
+        if (++m_position == 8) {
+            m_position = 0;
+            if (m_method == Method::CFB) {
+                m_prev = m_block;
+            } else if (!stream) {
+                m_cipher.processChunk(m_method, m_encrypt, m_block.data(), out + written,
+                                      1, m_prev);
+                written += 8;
+            }
+        }
+    }
+
+    // 2. Полные блоки обрабатываются напрямую (многоблочным ядром и пулом потоков).
+    const size_t full = m_position == 0 ? size / 8 : 0;
+    m_cipher.processChunk(m_method, m_encrypt, in, out + written, full, m_prev);
+    in += full * 8;
+    written += full * 8;
+    size -= full * 8;
+
+    // 3. Начинаем новый неполный блок из оставшихся байт.
+    if (size != 0 && stream)
+        nextGamma();
+    for (; size != 0; ++in, --size, ++m_position) {
+        if (stream) {
+            const byte_t c      = *in ^ m_gamma[m_position];
+            m_block[m_position] = m_encrypt ? c : *in;
+            out[written++]      = c;
+        } else {
+            m_block[m_position] = *in;
+        }
+    }
+    return written;
+}
+
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::Keystream::Keystream(const GOST_28147_89_Basic& cipher,
+                                                    Method method, size_t capacity,
+                                                    bool background)
+    : Keystream(cipher, method, cipher.m_initialization_vector, capacity, background)
+{
+}
+
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::Keystream::Keystream(const GOST_28147_89_Basic& cipher,
+                                                    Method method, const block_t& iv,
+                                                    size_t capacity, bool background)
+    : m_cipher(cipher)
+    , m_method(method)
+    , m_prev(iv)
+{
+    if (method != Method::OFB && method != Method::CTR)
+        throw std::invalid_argument("Keystream requires OFB or CTR mode.");
+
+    const size_t portion = KEYSTREAM_PORTION * sizeof(block_t);
+    m_buffer.resize(std::max<size_t>(1, (capacity + portion - 1) / portion) * portion);
+    if (background)
+        m_thread = std::thread(&Keystream::producerLoop, this);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Basic<ParamSet>::Keystream::~Keystream()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+}
+
+template <typename ParamSet>
+bool GOST_28147_89_Basic<ParamSet>::Keystream::generate()
+{
+    const size_t portion = KEYSTREAM_PORTION * sizeof(block_t);
+    size_t tail;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_buffer.size() - m_size < portion)
+            return false;
+        tail = (m_head + m_size) % m_buffer.size();
+    }
+
+    // Порции добавляются целиком, поэтому конец данных всегда выровнен по порции и
+    // порция помещается в буфер без разрыва. Потребитель не читает эту область, пока
+    // не увеличен m_size, поэтому гамма вырабатывается без блокировки: как
+    // шифрование нулевых блоков.
+    byte_t* out = m_buffer.data() + tail;
+    std::fill(out, out + portion, 0);
+    m_cipher.processBlocks(m_method, true, out, out, KEYSTREAM_PORTION, m_prev);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_size += portion;
+    }
+    m_condition.notify_all();
+    return true;
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::Keystream::producerLoop()
+{
+    const size_t portion = KEYSTREAM_PORTION * sizeof(block_t);
+    try {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(
+                    lock, [&] { return m_stop || m_buffer.size() - m_size >= portion; });
+                if (m_stop)
+                    return;
+            }
+            generate();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = std::current_exception();
+        m_condition.notify_all();
+    }
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::Keystream::prefill()
+{
+    if (!m_thread.joinable())
+        while (generate()) {
+        }
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::Keystream::apply(std::span<const std::byte> input,
+                                                       std::span<std::byte> output)
+{
+    if (output.size() < input.size())
+        throw std::length_error("Output buffer is too small.");
+
+    // Размер буфера кратен размеру блока, поэтому m_head % 8 - позиция в блоке.
+    CallStatistics statistics(m_method);
+    const size_t position = m_head % 8;
+    statistics.add(input.size(), (position + input.size() + 7) / 8 - (position + 7) / 8);
+    const byte_t* in = reinterpret_cast<const byte_t*>(input.data());
+    byte_t* out      = reinterpret_cast<byte_t*>(output.data());
+    size_t done      = 0;
+    while (done < input.size()) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_size == 0) {
+            // Гамма закончилась: ждем фоновый поток или вырабатываем ее сами.
+            if (!m_thread.joinable()) {
+                lock.unlock();
+                generate();
+                continue;
+            }
+            m_condition.wait(lock, [this] { return m_size != 0 || m_error; });
+            if (m_size == 0)
+                std::rethrow_exception(m_error);
+        }
+
+        const size_t n =
+            std::min({ input.size() - done, m_size, m_buffer.size() - m_head });
+        const byte_t* gamma = m_buffer.data() + m_head;
+        for (size_t i = 0; i < n; ++i)
+            out[done + i] = in[done + i] ^ gamma[i];
+        done += n;
+        m_head = (m_head + n) % m_buffer.size();
+        m_size -= n;
+        lock.unlock();
+        m_condition.notify_all();
+    }
+    return done;
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::Context::final(std::span<std::byte> output)
+{
+    // Пустое сообщение дополняется до целого блока, как и при шифровании за один
+    // вызов (см. outputSize).
+    if ((m_position == 0 && !m_empty) || isStreamMode())
+        return 0;
+    if (output.size() < 8)
+        throw std::length_error("Output buffer is too small.");
+
+    CallStatistics statistics(m_method);
+    statistics.add(0, 1);
+    std::fill(m_block.begin() + m_position, m_block.end(), 0);
+    m_cipher.processChunk(m_method, m_encrypt, m_block.data(),
+                          reinterpret_cast<byte_t*>(output.data()), 1, m_prev);
+    m_position = 0;
+    m_empty    = false;
+    return 8;
+}
+
+std::string
+GOST_28147_89_Common::generateOutputFilename(const std::string& input_filename,
+                                             const std::string& suffix,
+                                             const std::string& default_suffix) const
 {
     if (!suffix.empty())
         return suffix;
@@ -246,94 +895,353 @@ std::string GOST_28147_89::generateOutputFilename(const std::string& input_filen
     return base + default_suffix + ext;
 }
 
-void GOST_28147_89::encrypt(Method method, std::istream& is, std::ostream& os)
+void GOST_28147_89_Common::setThreadCount(size_t thread_count)
 {
-    m_stream = &is;
-    os << processStream(method, m_key, true);
+    if (thread_count == 1)
+        m_pool.reset();
+    else
+        m_pool = std::make_shared<ThreadPool>(thread_count);
 }
 
-void GOST_28147_89::encryptFile(const std::string& input_filename,
-                                const std::string& output_filename)
+void GOST_28147_89_Common::setFileIo(FileIo file_io)
+{
+    m_file_io = file_io;
+}
+
+void GOST_28147_89_Common::setChunkSize(size_t chunk_size)
+{
+    // Размер порции округляется вверх до целого числа блоков.
+    m_chunk_size = std::max<size_t>(8, (chunk_size + 7) & ~size_t(7));
+}
+
+size_t GOST_28147_89_Common::processingChunkSize() const
+{
+    // Порция делится между потоками на задачи не меньше MIN_BLOCKS_PER_TASK блоков:
+    // без увеличения порции 64 КБ по умолчанию загружали бы не больше 8 потоков.
+    if (!m_pool)
+        return m_chunk_size;
+    return std::max(m_chunk_size, m_pool->size() * TASKS_PER_THREAD
+                                      * MIN_BLOCKS_PER_TASK * sizeof(block_t));
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::encrypt(Method method, std::istream& is,
+                                            std::ostream& os) const
+{
+    processStream(method, m_initialization_vector, is, os, true);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::encrypt(Method method, const block_t& iv,
+                                            std::istream& is, std::ostream& os) const
+{
+    processStream(method, iv, is, os, true);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::encryptFile(const std::string& input_filename,
+                                                const std::string& output_filename) const
 {
     std::string out_filename =
         generateOutputFilename(input_filename, output_filename, "_encrypted");
-    std::ifstream infile(input_filename, std::ios::binary);
-    std::ofstream outfile(out_filename, std::ios::binary);
-    encrypt(Method::CTR, infile, outfile);
+    if (m_file_format == FileFormat::Container)
+        writeContainer(input_filename, out_filename, ParamSet::id, containerCipher(true));
+    else
+        processFile(input_filename, out_filename, true);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::decrypt(Method method, std::istream& is,
+                                            std::ostream& os) const
+{
+    processStream(method, m_initialization_vector, is, os, false);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::decrypt(Method method, const block_t& iv,
+                                            std::istream& is, std::ostream& os) const
+{
+    processStream(method, iv, is, os, false);
 }
 
-void GOST_28147_89::decrypt(Method method, std::istream& is, std::ostream& os)
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::encrypt(Method method,
+                                              std::span<const std::byte> input,
+                                              std::span<std::byte> output) const
 {
-    m_stream = &is;
-    os << processStream(method, m_key, false);
+    return processBuffer(method, m_initialization_vector, input, output, true);
 }
 
-void GOST_28147_89::decryptFile(const std::string& input_filename,
-                                const std::string& output_filename)
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::decrypt(Method method,
+                                              std::span<const std::byte> input,
+                                              std::span<std::byte> output) const
+{
+    return processBuffer(method, m_initialization_vector, input, output, false);
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::encrypt(Method method, const block_t& iv,
+                                              std::span<const std::byte> input,
+                                              std::span<std::byte> output) const
+{
+    return processBuffer(method, iv, input, output, true);
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::decrypt(Method method, const block_t& iv,
+                                              std::span<const std::byte> input,
+                                              std::span<std::byte> output) const
+{
+    return processBuffer(method, iv, input, output, false);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::encryptBatch(Method method,
+                                                 std::span<const Message> messages) const
+{
+    processBatch(method, true, messages);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::decryptBatch(Method method,
+                                                 std::span<const Message> messages) const
+{
+    processBatch(method, false, messages);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::encryptWithMac(Method method, std::istream& is,
+                                              std::ostream& os) const
+{
+    return encryptWithMac(method, m_initialization_vector, is, os);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::decryptWithMac(Method method, std::istream& is,
+                                              std::ostream& os) const
+{
+    return decryptWithMac(method, m_initialization_vector, is, os);
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::encryptWithMac(Method method,
+                                                     std::span<const std::byte> input,
+                                                     std::span<std::byte> output,
+                                                     block_t& mac) const
+{
+    return encryptWithMac(method, m_initialization_vector, input, output, mac);
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::decryptWithMac(Method method,
+                                                     std::span<const std::byte> input,
+                                                     std::span<std::byte> output,
+                                                     block_t& mac) const
+{
+    return decryptWithMac(method, m_initialization_vector, input, output, mac);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::encryptWithMac(Method method, const block_t& iv,
+                                              std::istream& is, std::ostream& os) const
+{
+    MacState mac;
+    processStream(method, iv, is, os, true, &mac);
+    return finalMac(mac);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::decryptWithMac(Method method, const block_t& iv,
+                                              std::istream& is, std::ostream& os) const
+{
+    MacState mac;
+    processStream(method, iv, is, os, false, &mac);
+    return finalMac(mac);
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::encryptWithMac(Method method, const block_t& iv,
+                                                     std::span<const std::byte> input,
+                                                     std::span<std::byte> output,
+                                                     block_t& mac) const
+{
+    MacState state;
+    const size_t size = processBuffer(method, iv, input, output, true, &state);
+    mac               = finalMac(state);
+    return size;
+}
+
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::decryptWithMac(Method method, const block_t& iv,
+                                                     std::span<const std::byte> input,
+                                                     std::span<std::byte> output,
+                                                     block_t& mac) const
+{
+    MacState state;
+    const size_t size = processBuffer(method, iv, input, output, false, &state);
+    mac               = finalMac(state);
+    return size;
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::computeMac(std::istream& is) const
+{
+    MacState mac;
+    std::vector<byte_t> buffer(processingChunkSize());
+    bool processed = false;
+    while (is) {
+        is.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<std::streamsize>(buffer.size()));
+        const size_t count = static_cast<size_t>(is.gcount());
+        if (count == 0 && processed)
+            break;
+
+        const size_t padded = outputSize(count);
+        std::fill(buffer.begin() + count, buffer.begin() + padded, 0);
+        updateMac(mac, buffer.data(), padded / 8);
+        processed = true;
+    }
+    return finalMac(mac);
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::block_t
+GOST_28147_89_Basic<ParamSet>::computeMac(std::span<const std::byte> input) const
+{
+    MacState mac;
+    const byte_t* in  = reinterpret_cast<const byte_t*>(input.data());
+    const size_t full = input.size() / 8;
+    updateMac(mac, in, full);
+    if (outputSize(input.size()) > full * 8) {
+        block_t block = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        std::memcpy(block.data(), in + full * 8, input.size() - full * 8);
+        updateMac(mac, block.data(), 1);
+    }
+    return finalMac(mac);
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::decryptFile(const std::string& input_filename,
+                                                const std::string& output_filename) const
 {
     std::string out_filename =
         generateOutputFilename(input_filename, output_filename, "_plaintext");
     out_filename.replace(out_filename.rfind("_encrypted"), 10, "");
+    if (m_file_format == FileFormat::Container)
+        decryptContainer(input_filename, out_filename, ParamSet::id,
+                         containerCipher(false));
+    else
+        processFile(input_filename, out_filename, false);
+}
 
-    std::ifstream infile(input_filename, std::ios::binary);
-    std::ofstream outfile(out_filename, std::ios::binary);
-    decrypt(Method::CTR, infile, outfile);
-}
-
-GOST_28147_89::block_t GOST_28147_89::read_block()
-{
-    block_t block = { 0, 0, 0, 0, 0, 0, 0, 0 }; // Инициализируем блок нулями
-
-    m_stream->read(reinterpret_cast<char*>(block.data()),
-                   8); // Читаем до 8 байтов напрямую в блок
-    m_stream->peek();  // Обновление значения EOF (EndOfFile)
-
-#ifdef PR_DEBUG
-    std::cout << "[ READ ]\t: ";
-    for (const auto& b : block)
-        std::cout << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b)
-                  << " ";
-    std::cout << std::endl;
-#endif
-
-    return block;
-}
-
-/**
- * Пример:
- * Входной блок {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF} :
- * - Последний байт (0xFF) увеличивается и становится 0x00 из-за переполнения.
- * - Перенос передается на предыдущий байт (также 0xFF), который увеличивается и также
- * становится 0x00.
- * - Так как был перенос из наименее значимого байта, следующий байт слева (в нашем
- * случае, шестой) увеличивается на единицу и становится 0x01.
- * - Остальные байты слева остаются без изменений.
- * В итоге, наш блок преобразуется в {0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00}.
- */
-GOST_28147_89::block_t GOST_28147_89::incrementCounter(const block_t& block)
-{
-    block_t incremented_block = block;
-    for (auto it = incremented_block.rbegin(); it != incremented_block.rend(); ++it) {
-        if (++(*it) != 0) // Если текущий байт не переполнился после инкремента
-            return incremented_block;
+template <typename ParamSet>
+size_t GOST_28147_89_Basic<ParamSet>::readContainer(const std::string& filename,
+                                                    uint64_t offset,
+                                                    std::span<std::byte> output) const
+{
+    return readContainerRange(filename, ParamSet::id, offset, output,
+                              containerCipher(false));
+}
+
+template <typename ParamSet>
+GOST_28147_89_Common::ChunkCipher
+GOST_28147_89_Basic<ParamSet>::containerCipher(bool isEncrypting) const
+{
+    return [this, isEncrypting](Method method, const block_t& nonce, size_t length,
+                                std::span<const std::byte> header,
+                                std::span<const std::byte> input,
+                                std::span<std::byte> output, block_t* mac)
+    {
+        if (!mac) {
+            processBuffer(method, nonce, input, output, isEncrypting);
+            return;
+        }
+
+        // Имитовставка учитывает заголовок контейнера, вектор инициализации и длину
+        // участка, поэтому нельзя незаметно изменить параметры контейнера (например,
+        // снять флаг имитовставки), а участки - переставить или укоротить.
+        MacState state;
+        const block_t size = bitsToBlock<uint64_t, 8>(length);
+        updateMac(state, reinterpret_cast<const byte_t*>(header.data()),
+                  header.size() / 8);
+        updateMac(state, nonce.data(), 1);
+        updateMac(state, size.data(), 1);
+        if (length != 0)
+            processBuffer(method, nonce, input, output, isEncrypting, &state);
+        *mac = finalMac(state);
+    };
+}
+
+template <typename ParamSet>
+void GOST_28147_89_Basic<ParamSet>::processFile(const std::string& input_filename,
+                                                const std::string& output_filename,
+                                                bool isEncrypt) const
+{
+    if (m_file_io == FileIo::Mapped) {
+        auto process = [&](std::span<const std::byte> input, std::span<std::byte> output)
+        {
+            processBuffer(Method::CTR, m_initialization_vector, input, output, isEncrypt);
+        };
+        if (processMappedFile(input_filename, output_filename, process))
+            return;
+    }
+
+    // Конвейер используется и тогда, когда файл нельзя отобразить в память: в
+    // отличие от потоков ниже он умеет обрабатывать файл на месте.
+    {
+        // Порции поступают по порядку, поэтому счетчик переносится между ними.
+        CallStatistics statistics(Method::CTR);
+        block_t prev = m_initialization_vector;
+        auto process = [&](std::span<std::byte> chunk)
+        {
+            byte_t* data = reinterpret_cast<byte_t*>(chunk.data());
+            processChunk(Method::CTR, isEncrypt, data, data, chunk.size() / 8, prev);
+            statistics.add(chunk.size(), chunk.size() / 8);
+        };
+        if (processPipelinedFile(input_filename, output_filename,
+                                 m_file_io == FileIo::DirectPipeline, process))
+            return;
     }
 
-    // Если цикл завершился, это означает переполнение для всего блока
-    throw std::runtime_error("Counter overflow detected");
+    // Конвейер не смог открыть файлы. Отсутствующий входной файл - ошибка, а не
+    // повод создать пустой выходной.
+    std::ifstream infile(input_filename, std::ios::binary);
+    if (!infile)
+        throw std::runtime_error("Failed to open input file.");
+
+    // std::ofstream обрезает выходной файл до чтения входного, поэтому файл нельзя
+    // обработать потоками на месте.
+    std::error_code error;
+    if (std::filesystem::equivalent(input_filename, output_filename, error))
+        throw std::runtime_error("Failed to open file for in-place processing.");
+
+    std::ofstream outfile(output_filename, std::ios::binary);
+    if (!outfile)
+        throw std::runtime_error("Failed to open output file.");
+    processStream(Method::CTR, m_initialization_vector, infile, outfile, isEncrypt);
+}
+
+GOST_28147_89_Common::block_t
+GOST_28147_89_Common::advanceCounter(const block_t& block, uint64_t n) const
+{
+    const uint64_t counter = blockToBits<uint64_t>(block);
+    if (counter > UINT64_MAX - n)
+        throw std::runtime_error("Counter overflow detected");
+    return bitsToBlock<uint64_t, 8>(counter + n);
 }
 
 //
 // Utilities
 //
 
-template <size_t S>
-std::string GOST_28147_89::blockToString(const std::array<byte_t, S>& text_block)
-{
-    return std::string(text_block.begin(), text_block.end());
-}
-
 template <typename T, size_t S>
-T GOST_28147_89::blockToBits(const std::array<byte_t, S>& block)
+T GOST_28147_89_Common::blockToBits(const std::array<byte_t, S>& block) const
 {
     T bits = 0;
     for (size_t i = 0; i < block.size(); ++i)
@@ -342,7 +1250,8 @@ T GOST_28147_89::blockToBits(const std::array<byte_t, S>& block)
 }
 
 template <typename T, size_t S>
-std::array<GOST_28147_89::byte_t, S> GOST_28147_89::bitsToBlock(const T& bits)
+std::array<GOST_28147_89_Common::byte_t, S>
+GOST_28147_89_Common::bitsToBlock(const T& bits) const
 {
     std::array<byte_t, S> result;
     for (size_t i = 0; i < S; ++i)
@@ -350,20 +1259,8 @@ std::array<GOST_28147_89::byte_t, S> GOST_28147_89::bitsToBlock(const T& bits)
     return result;
 };
 
-/**
- * Пример:
- * Если num = 0xA23FB45CDE678910 и position = 3:
- * 1. Вычисляем маску для битов: (0xFull << (position * 4))
- *    0xFull = 1111 (в двоичном виде)
- *    position * 4 = 12 (сдвигаем на 12 битов влево)
- *    Маска становится: 0xF000
- * 2. Применяем операцию И (bitwise AND) между num и маской. Это обнуляет все биты в
- * num, кроме интересующего нас 4-битного блока. num & 0xF000 = 0xB0000
- * 3. Сдвигаем результат на (position * 4) позиций вправо, чтобы получить итоговое
- * 4-битное значение. 0xB0000 >> 12 = 0xB Функция вернёт значение 0xB для указанного
- * примера.
- */
-inline uint32_t GOST_28147_89::extract4Bits(const uint64_t num, const size_t position)
-{
-    return (num & (0xFull << (position * 4))) >> (position * 4);
-}
\ No newline at end of file
+template class GOST_28147_89_Basic<CryptoPro_A_ParamSet>;
+template class GOST_28147_89_Basic<CryptoPro_B_ParamSet>;
+template class GOST_28147_89_Basic<CryptoPro_C_ParamSet>;
+template class GOST_28147_89_Basic<CryptoPro_D_ParamSet>;
+template class GOST_28147_89_Basic<TC26_Z_ParamSet>;
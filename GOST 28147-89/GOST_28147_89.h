@@ -2,12 +2,35 @@
 #define GOST_28147_89_H
 
 #include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
 #include <vector>
 
-class GOST_28147_89
+#include "ParamSets.h"
+
+class ThreadPool;
+class KernelRegistry;
+class JitCipher;
+
+/**
+ * Общая часть шифра ГОСТ 28147-89, не зависящая от набора S-блоков: ключ и
+ * развернутые раундовые ключи, вектор инициализации и настройки обработки.
+ */
+class GOST_28147_89_Common
 {
+    // Выбирает ядро шифрования (GOST_28147_89_kernels.cpp).
+    friend class KernelRegistry;
+
 public:
     enum class Method
     {
@@ -18,16 +41,68 @@ public:
         CTR, // Counter
     };
 
-    using byte_t  = unsigned char;
-    using block_t = std::array<byte_t, 8>;
+    // Количество режимов шифрования (размер таблицы статистики).
+    static constexpr size_t METHOD_COUNT = 5;
 
     /**
-     * Конструктор класса для шифрования ГОСТ 28147-89.
-     * Инициализирует объект с заданным ключом.
-     * Ключ должен иметь размер 32 байта.
-     * @param key Указатель на символьное представление ключа.
+     * Способ обработки файлов в encryptFile и decryptFile.
+     */
+    enum class FileIo
+    {
+        Pipeline,       // Конвейер чтение - шифрование - запись в разных потоках
+        DirectPipeline, // Конвейер с прямым вводом-выводом (O_DIRECT в Linux)
+        Mapped,         // Отображение файлов в память
+    };
+
+    /**
+     * Формат файлов encryptFile и decryptFile.
+     */
+    enum class FileFormat
+    {
+        Raw,       // Шифротекст без заголовка, дополненный нулями до целого блока
+        Container, // Контейнер из независимых участков с заголовком и оглавлением
+    };
+
+    using byte_t        = unsigned char;
+    using block_t       = std::array<byte_t, 8>;
+    using round_keys_t  = std::array<uint32_t, 32>;
+    using s_blocks_t    = std::array<std::array<byte_t, 16>, 8>;
+    using round_table_t = std::array<std::array<uint32_t, 256>, 4>;
+
+    /**
+     * Независимое сообщение для пакетной обработки (см. encryptBatch).
+     */
+    struct Message
+    {
+        std::span<const std::byte> input;
+        // Буфер результата размером не менее outputSize(input.size()) байт; может
+        // совпадать с input.
+        std::span<std::byte> output;
+        // Вектор инициализации (начальное значение счетчика) этого сообщения.
+        block_t iv;
+    };
+
+    /**
+     * Заменяет ключ шифрования.
+     * Ключ разворачивается один раз в последовательности раундовых ключей для
+     * зашифрования и расшифрования, поэтому смена ключа не требует создания нового
+     * объекта и не добавляет работы при обработке каждого блока.
+     * @param key Указатель на символьное представление ключа (32 байта).
+     */
+    void rekey(const char* key);
+
+    /**
+     * Заменяет ключ шифрования, заданный произвольными 32 байтами (в том числе
+     * содержащими нулевые байты).
+     * @param key Ключ (32 байта).
+     */
+    void rekey(std::span<const std::byte, 32> key);
+
+    /**
+     * Стирает область памяти. В отличие от memset, запись не удаляется компилятором
+     * как ненужная, поэтому функция подходит для уничтожения ключевого материала.
      */
-    GOST_28147_89(const char* key);
+    static void secureWipe(void* data, size_t size);
 
     /**
      * Задает вектор инициализации.
@@ -38,40 +113,387 @@ public:
      * @param iv - вектор инициализации (8 символов).
      */
     void setInitializationVector(const char* iv);
-    void encrypt(Method method, std::istream& is, std::ostream& os);
-    void encryptFile(const std::string& input_filename,
-                     const std::string& output_filename = "");
-    void decrypt(Method method, std::istream& is, std::ostream& os);
-    void decryptFile(const std::string& input_filename,
-                     const std::string& output_filename = "");
 
-private:
     /**
-     * id-Gost28147-89-CryptoPro-A-ParamSet
-     * https://ru.wikipedia.org/wiki/%D0%93%D0%9E%D0%A1%D0%A2_28147-89#%D0%98%D0%B4%D0%B5%D0%BD%D1%82%D0%B8%D1%84%D0%B8%D0%BA%D0%B0%D1%82%D0%BE%D1%80:_id-Gost28147-89-CryptoPro-A-ParamSet
-     * Матрица подстановок (S-блоки) для GOST 28147-89.
-     */
-    // clang-format off
-    static constexpr std::array<std::array<GOST_28147_89::byte_t, 16>, 8> m_s_blocks = {
-        0x9, 0x6, 0x3, 0x2, 0x8, 0xB, 0x1, 0x7, 0xA, 0x4, 0xE, 0xF, 0xC, 0x0, 0xD, 0x5,
-        0x3, 0x7, 0xE, 0x9, 0x8, 0xA, 0xF, 0x0, 0x5, 0x2, 0x6, 0xC, 0xB, 0x4, 0xD, 0x1,
-        0xE, 0x4, 0x6, 0x2, 0xB, 0x3, 0xD, 0x8, 0xC, 0xF, 0x5, 0xA, 0x0, 0x7, 0x1, 0x9,
-        0xE, 0x7, 0xA, 0xC, 0xD, 0x1, 0x3, 0x9, 0x0, 0x2, 0xB, 0x4, 0xF, 0x8, 0x5, 0x6,
-        0xB, 0x5, 0x1, 0x9, 0x8, 0xD, 0xF, 0x0, 0xE, 0x4, 0x2, 0x3, 0xC, 0x7, 0xA, 0x6,
-        0x3, 0xA, 0xD, 0xC, 0x1, 0x2, 0x0, 0xB, 0x7, 0x5, 0x9, 0x4, 0x8, 0xF, 0xE, 0x6,
-        0x1, 0xD, 0x2, 0x9, 0x7, 0xA, 0x6, 0x0, 0x8, 0xC, 0x4, 0x5, 0xF, 0x3, 0xB, 0xE,
-        0xB, 0xA, 0xF, 0x5, 0x0, 0xC, 0xE, 0x8, 0x6, 0x2, 0x3, 0x9, 0x1, 0x7, 0xD, 0x4,
+     * Задает размер порции, которой данные читаются из входного потока и
+     * записываются в выходной. Память, используемая при шифровании, ограничена этим
+     * размером и не зависит от объема данных. При параллельной обработке порция не
+     * меньше 32 КБ на поток (см. setThreadCount).
+     * @param chunk_size - размер порции в байтах (округляется вверх до кратного 8).
+     */
+    void setChunkSize(size_t chunk_size);
+
+    /**
+     * Задает количество потоков для параллельной обработки.
+     * Параллельно обрабатываются режимы ECB и CTR, а также расшифрование в режимах CBC
+     * и CFB; результат совпадает с последовательной обработкой байт в байт. Каждая
+     * порция данных делится между потоками на участки не меньше 8 КБ, поэтому при
+     * большом количестве потоков порция (см. setChunkSize) автоматически увеличивается
+     * до размера, достаточного для загрузки всех потоков.
+     * @param thread_count - количество потоков (1 - последовательная обработка,
+     * 0 - по числу ядер процессора).
+     */
+    void setThreadCount(size_t thread_count);
+
+    /**
+     * Задает способ обработки файлов (по умолчанию FileIo::Pipeline).
+     * Конвейер читает следующую порцию (см. setChunkSize) и записывает предыдущую,
+     * пока шифруется текущая, поэтому ввод-вывод и вычисления перекрываются. Прямой
+     * ввод-вывод минует кэш страниц ОС и полезен для больших файлов на быстрых
+     * накопителях; если файловая система его не поддерживает, используется обычный.
+     * Если выбранный способ неприменим к файлу, используется потоковая обработка.
+     */
+    void setFileIo(FileIo file_io);
+
+    /**
+     * Задает формат файлов (по умолчанию FileFormat::Raw, всегда в режиме CTR).
+     *
+     * Контейнер начинается с заголовка (режим, набор параметров, вектор
+     * инициализации, исходная длина и размер участка) и состоит из участков по
+     * setChunkSize байт открытого текста. Каждый участок шифруется независимо со
+     * своим вектором инициализации (вектор файла плюс номер первого блока участка) и
+     * хранит его, свою длину и, при mac == true, имитовставку. Оглавление в конце
+     * файла позволяет расшифровывать участки параллельно и читать произвольный
+     * диапазон (см. readContainer). Если запись контейнера прервалась, повторный
+     * encryptFile с теми же параметрами продолжает ее с первого незаписанного
+     * участка. Расшифрованный файл имеет исходную длину. Способ обработки, заданный
+     * setFileIo, к контейнеру не применяется.
+     *
+     * При compress == true каждый участок перед шифрованием сжимается (LZ4, см.
+     * Lz4.h) и сохраняется сжатым, если это его уменьшает; флаг сжатия записывается
+     * в заголовок, а decryptFile и readContainer распаковывают участки сами. Для
+     * хорошо сжимаемых данных (журналы, CSV) через шифр и накопитель проходит во
+     * столько же раз меньше байт. Сжатие раскрывает степень сжимаемости каждого
+     * участка по его длине.
+     * @param method - режим шифрования участков контейнера.
+     * @param mac - вырабатывать и проверять имитовставку каждого участка.
+     * @param compress - сжимать участки перед шифрованием.
+     */
+    void setFileFormat(FileFormat file_format, Method method = Method::CTR,
+                       bool mac = true, bool compress = false);
+
+    /**
+     * Накопленная статистика шифрования в одном режиме (см. statistics).
+     */
+    struct MethodStatistics
+    {
+        uint64_t calls       = 0; // Количество вызовов
+        uint64_t bytes       = 0; // Обработано байт входных данных
+        uint64_t blocks      = 0; // Обработано блоков (с учетом дополнения)
+        uint64_t nanoseconds = 0; // Суммарное время вызовов
+        uint64_t cycles      = 0; // Такты процессора (см. enableCycleCounting)
+
+        double megabytesPerSecond() const
+        {
+            return nanoseconds == 0 ? 0 : static_cast<double>(bytes) * 1e3 / nanoseconds;
+        }
+
+        double nanosecondsPerCall() const
+        {
+            return calls == 0 ? 0 : static_cast<double>(nanoseconds) / calls;
+        }
+
+        double cyclesPerByte() const
+        {
+            return bytes == 0 ? 0 : static_cast<double>(cycles) / bytes;
+        }
     };
-    // clang-format on
 
-    std::string processStream(Method method, const std::array<uint32_t, 8>& key,
-                              bool isEncrypting);
+    /**
+     * true, если библиотека собрана со сбором статистики (GOST_STATISTICS). Без него
+     * учет вызовов удаляется компилятором полностью, а statistics возвращает нули.
+     */
+#ifdef GOST_STATISTICS
+    static constexpr bool statisticsEnabled = true;
+#else
+    static constexpr bool statisticsEnabled = false;
+#endif
 
     /**
-     * Читает блок из входного потока (8 байт).
-     * @return Блок данных.
+     * Возвращает статистику всех объектов шифра в процессе, например для панелей
+     * мониторинга. Учитываются вызовы открытых функций шифрования (потоки, память,
+     * файлы, пакеты, контексты); счетчики обновляются атомарно без упорядочивания,
+     * поэтому значения разных полей могут относиться к немного разным моментам.
+     * @return Статистика по режимам, индекс - static_cast<size_t>(Method).
      */
-    block_t read_block();
+    static std::array<MethodStatistics, METHOD_COUNT> statistics();
+
+    /**
+     * Обнуляет статистику.
+     */
+    static void resetStatistics();
+
+    /**
+     * Включает подсчет тактов процессора, затраченных вызывающим потоком
+     * (perf_event_open в Linux). Каждый вызов при этом дважды читает счетчик
+     * системным вызовом, поэтому по умолчанию подсчет выключен.
+     * @return true, если счетчик тактов доступен и подсчет включен.
+     */
+    static bool enableCycleCounting(bool enable);
+
+    /**
+     * Ядро шифрования последовательности независимых блоков (см. setKernel).
+     */
+    struct KernelInfo
+    {
+        std::string name;       // Имя для setKernel
+        size_t width   = 1;     // Количество блоков, обрабатываемых за один шаг
+        bool supported = false; // Процессор поддерживает необходимые команды
+        bool verified  = false; // Результат совпал с эталонным при самопроверке
+    };
+
+    /**
+     * Возвращает ядра, собранные в библиотеке, от самого быстрого к самому
+     * медленному. При первом обращении к шифрованию для каждого ядра проверяется
+     * поддержка процессором (cpuid), а его результат сравнивается с эталонной
+     * скалярной реализацией, которая сама проверяется по контрольному примеру
+     * ГОСТ Р 34.13-2015. Выбирается самое быстрое ядро, прошедшее проверку.
+     */
+    static std::vector<KernelInfo> kernels();
+
+    /**
+     * @return Имя выбранного ядра.
+     */
+    static std::string kernel();
+
+    /**
+     * Выбирает ядро для всех объектов шифра в процессе, например для сравнения ядер
+     * в тестах производительности. Блоки, оставшиеся после ядра (их количество не
+     * кратно его ширине), обрабатываются следующими более медленными ядрами.
+     * @param name - имя ядра (см. kernels) или "auto" для самого быстрого.
+     * @return false, если ядро неизвестно, не поддерживается или не прошло
+     * самопроверку; выбор при этом не меняется.
+     */
+    static bool setKernel(const std::string& name);
+
+    /**
+     * @return true, если независимые блоки шифруются кодом, сгенерированным для
+     * текущего ключа (см. setJit).
+     */
+    bool jitEnabled() const { return m_jit != nullptr; }
+
+    /**
+     * @param input_size - размер входных данных в байтах.
+     * @return Размер результата шифрования: входные данные, дополненные до целого
+     * числа блоков (пустые данные превращаются в один нулевой блок).
+     */
+    static constexpr size_t outputSize(size_t input_size)
+    {
+        return input_size == 0 ? 8 : (input_size + 7) & ~size_t(7);
+    }
+
+protected:
+    GOST_28147_89_Common()                                       = default;
+    GOST_28147_89_Common(const GOST_28147_89_Common&)            = default;
+    GOST_28147_89_Common& operator=(const GOST_28147_89_Common&) = default;
+
+    /**
+     * Стирает ключ и раундовые ключи, чтобы они не оставались в освобожденной памяти.
+     */
+    ~GOST_28147_89_Common();
+
+    /**
+     * Учет одного вызова в статистике (GOST_28147_89_statistics.cpp): время
+     * измеряется от создания объекта до его уничтожения. Без GOST_STATISTICS класс
+     * пуст, и компилятор удаляет его использование полностью.
+     */
+    class CallStatistics
+    {
+    public:
+#ifdef GOST_STATISTICS
+        explicit CallStatistics(Method method);
+        ~CallStatistics();
+
+        CallStatistics(const CallStatistics&)            = delete;
+        CallStatistics& operator=(const CallStatistics&) = delete;
+
+        void add(uint64_t bytes, uint64_t blocks)
+        {
+            m_bytes += bytes;
+            m_blocks += blocks;
+        }
+
+    private:
+        Method m_method;
+        uint64_t m_bytes  = 0;
+        uint64_t m_blocks = 0;
+        int64_t m_start;
+        bool m_count_cycles;
+        uint64_t m_start_cycles;
+#else
+        explicit CallStatistics(Method) {}
+        void add(uint64_t, uint64_t) {}
+#endif
+    };
+
+    /**
+     * Строит четыре таблицы замены по 256 элементов из матрицы S-блоков.
+     * Таблица j объединяет пару S-блоков (2j, 2j + 1), обрабатывающих j-й байт
+     * 32-битного числа, и уже содержит результат циклического сдвига на 11 позиций
+     * влево. Таким образом, вся функция f сводится к сложению и четырем выборкам.
+     *
+     * Пример (CryptoPro-A):
+     * Байт 0x9B числа A_bits обрабатывается таблицей 0:
+     * - младшие 4 бита (0xB) заменяются по S-блоку 0: s_blocks[0][0xB] = 0xF;
+     * - старшие 4 бита (0x9) заменяются по S-блоку 1: s_blocks[1][0x9] = 0x2;
+     * - получаем 0x2F, сдвигаем на место байта и выполняем циклический сдвиг на 11.
+     * Так как S-блоки заменяют непересекающиеся биты, результаты четырех таблиц
+     * объединяются операцией XOR.
+     * @param s_blocks - матрица подстановок.
+     * @return Таблицы замены для данного набора S-блоков.
+     */
+    static constexpr round_table_t buildRoundTables(const s_blocks_t& s_blocks)
+    {
+        round_table_t tables {};
+        for (size_t j = 0; j < 4; ++j) {
+            for (uint32_t b = 0; b < 256; ++b) {
+                uint32_t s = static_cast<uint32_t>(s_blocks[2 * j][b & 0xF])
+                             | static_cast<uint32_t>(s_blocks[2 * j + 1][b >> 4]) << 4;
+                s <<= 8 * j;
+                tables[j][b] = (s << 11) | (s >> 21);
+            }
+        }
+        return tables;
+    }
+
+    /**
+     * @return true, если блоки в данном режиме можно обрабатывать независимо.
+     */
+    static bool isParallelizable(Method method, bool isEncrypting);
+
+    /**
+     * Шифрует последовательность независимых блоков выбранным ядром
+     * (GOST_28147_89_kernels.cpp).
+     * @param tables - таблицы замены набора параметров.
+     */
+    static void runKernels(const round_table_t& tables, const round_keys_t& schedule,
+                           const byte_t* in, byte_t* out, size_t count);
+
+    /**
+     * Векторное ядро шифрования на AVX2 (GOST_28147_89_avx2.cpp).
+     * @param tables - таблицы замены набора параметров.
+     * @return Количество обработанных блоков (кратно 8).
+     */
+    static size_t block_cipher_avx2(const round_table_t& tables,
+                                    const round_keys_t& schedule, const byte_t* in,
+                                    byte_t* out, size_t count);
+
+    /**
+     * Векторное ядро шифрования на AVX-512 (GOST_28147_89_avx512.cpp).
+     * @return Количество обработанных блоков (кратно 16).
+     */
+    static size_t block_cipher_avx512(const round_table_t& tables,
+                                      const round_keys_t& schedule, const byte_t* in,
+                                      byte_t* out, size_t count);
+
+    /**
+     * Генерирует код шифрования для текущего ключа и таблиц замены tables
+     * (GOST_28147_89_jit.cpp) и проверяет его по общему ядру. rekey повторяет
+     * генерацию для нового ключа.
+     * @param tables - таблицы замены или nullptr, чтобы выключить генерацию.
+     * @return false, если генерация недоступна или код не прошел проверку.
+     */
+    bool enableJit(const round_table_t* tables);
+
+    /**
+     * Шифрует сгенерированным кодом наибольшее число блоков, кратное его ширине.
+     * @param schedule - m_encrypt_schedule или m_decrypt_schedule.
+     * @return Количество обработанных блоков (0, если код не создан).
+     */
+    size_t runJit(const round_keys_t& schedule, const byte_t* in, byte_t* out,
+                  size_t count) const;
+
+    /**
+     * Обрабатывает сгенерированным кодом блоки в режиме CTR, начиная со значения
+     * счетчика counter.
+     * @return Количество обработанных блоков (0, если код не создан или счетчик
+     * переполнится).
+     */
+    size_t runJitCounter(uint64_t counter, const byte_t* in, byte_t* out,
+                         size_t count) const;
+
+    /**
+     * @return true, если процессор и ОС поддерживают AVX2.
+     */
+    static bool hasAvx2();
+
+    /**
+     * @return true, если процессор и ОС поддерживают AVX-512F.
+     */
+    static bool hasAvx512();
+
+    /**
+     * Отображает входной и выходной файлы в память (GOST_28147_89_mmap.cpp) и
+     * передает отображения функции обработки. Выходной файл создается длиной
+     * outputSize от длины входного. Если выходной файл совпадает с входным, обе
+     * области указывают на одно отображение.
+     * @return false, если файл нельзя отобразить в память; в этом случае следует
+     * использовать конвейер или потоковую обработку. Файл, обрабатываемый на месте,
+     * при этом не изменяется.
+     */
+    bool processMappedFile(
+        const std::string& input_filename, const std::string& output_filename,
+        const std::function<void(std::span<const std::byte>, std::span<std::byte>)>&
+            process) const;
+
+    /**
+     * Обрабатывает файл конвейером из трех стадий (GOST_28147_89_pipeline.cpp):
+     * чтение, обработка и запись выполняются в разных потоках над кольцом
+     * выровненных буферов. Функция обработки получает порции по порядку; последняя
+     * неполная порция дополнена нулями до целого числа блоков.
+     * @param direct - использовать прямой ввод-вывод, если он поддерживается.
+     * @return false, если файлы нельзя открыть; в этом случае следует использовать
+     * потоковую обработку.
+     */
+    bool processPipelinedFile(const std::string& input_filename,
+                              const std::string& output_filename, bool direct,
+                              const std::function<void(std::span<std::byte>)>& process)
+        const;
+
+    /**
+     * Шифрует или расшифровывает участок контейнера.
+     * @param nonce - вектор инициализации участка.
+     * @param length - длина открытого текста участка.
+     * @param header - заголовок контейнера (целое число блоков), который учитывается
+     * в имитовставке, чтобы его нельзя было незаметно изменить.
+     * @param input - открытый текст (length байт) или шифротекст
+     * (outputSize(length) байт).
+     * @param mac - имитовставка участка или nullptr, если она не нужна. При
+     * length == 0 данные не обрабатываются, а имитовставка вырабатывается только по
+     * header, nonce и длине и одинакова при зашифровании и расшифровании.
+     */
+    using ChunkCipher = std::function<void(
+        Method method, const block_t& nonce, size_t length,
+        std::span<const std::byte> header, std::span<const std::byte> input,
+        std::span<std::byte> output, block_t* mac)>;
+
+    /**
+     * Записывает контейнер (GOST_28147_89_container.cpp), продолжая прерванную
+     * запись, если это возможно. Участки шифруются функцией cipher в пуле потоков.
+     * @param param_set - идентификатор набора параметров шифра.
+     */
+    void writeContainer(const std::string& input_filename,
+                        const std::string& output_filename, unsigned char param_set,
+                        const ChunkCipher& cipher) const;
+
+    /**
+     * Расшифровывает контейнер в файл исходной длины.
+     * @throw std::runtime_error - файл не является полным контейнером, создан с
+     * другим набором параметров или ключом, не содержит имитовставок, хотя они
+     * заданы setFileFormat, или не совпадает имитовставка участка.
+     */
+    void decryptContainer(const std::string& input_filename,
+                          const std::string& output_filename, unsigned char param_set,
+                          const ChunkCipher& cipher) const;
+
+    /**
+     * Расшифровывает диапазон открытого текста контейнера, обрабатывая только
+     * участки, которые его содержат.
+     * @return Количество записанных байт.
+     */
+    size_t readContainerRange(const std::string& filename, unsigned char param_set,
+                              uint64_t offset, std::span<std::byte> output,
+                              const ChunkCipher& cipher) const;
 
     std::string generateOutputFilename(const std::string& input_filename,
                                        const std::string& suffix,
@@ -83,15 +505,7 @@ private:
      * @return Число, представляющее блок данных.
      */
     template <typename T, size_t S>
-    T blockToBits(const std::array<byte_t, S>& block);
-
-    /**
-     * Преобразует блок данных в строку.
-     * @param text_block - блок данных.
-     * @return Строка, представляющая блок данных.
-     */
-    template <size_t S>
-    std::string blockToString(const std::array<byte_t, S>& text_block);
+    T blockToBits(const std::array<byte_t, S>& block) const;
 
     /**
      * Преобразует число в блок данных.
@@ -99,56 +513,545 @@ private:
      * @return Блок данных, представляющий число.
      */
     template <typename T, size_t S>
-    std::array<byte_t, S> bitsToBlock(const T& bits);
+    std::array<byte_t, S> bitsToBlock(const T& bits) const;
 
     /**
-     * Извлекает 4-битный блок из 64-битного числа на заданной позиции.
-     * @param num 64-битное число, из которого будут извлечены биты.
-     * @param position Позиция, с которой начинается 4-битный блок. Позиция 0
-     * соответствует младшим (самым правым) 4-м битам.
-     * @return Извлеченное 4-битное значение.
+     * Увеличивает значение счетчика на n, рассматривая блок как 64-битное число.
+     * @param block - исходное значение счетчика.
+     * @param n - величина приращения.
+     * @return Новое значение счетчика.
      */
-    inline uint32_t extract4Bits(const uint64_t num, const size_t position);
+    block_t advanceCounter(const block_t& block, uint64_t n) const;
 
     /**
-     * Применяет S-блоки к 32-битному числу и ключу.
-     * @param A - 32-битное число в виде массива из 4 байт.
+     * Минимальное количество блоков на одну задачу, при котором распараллеливание
+     * окупает накладные расходы на синхронизацию.
+     */
+    static constexpr size_t MIN_BLOCKS_PER_TASK = 1024;
+
+    /**
+     * Количество задач на поток пула в одной порции: с запасом, чтобы потоки,
+     * закончившие раньше, забирали работу у отстающих.
+     */
+    static constexpr size_t TASKS_PER_THREAD = 4;
+
+    /**
+     * @return Размер порции, которой данные читаются из потока или файла: m_chunk_size,
+     * но при заданном пуле не меньше, чем нужно для загрузки всех его потоков
+     * (размер пула * TASKS_PER_THREAD * MIN_BLOCKS_PER_TASK блоков).
+     */
+    size_t processingChunkSize() const;
+
+    // Protected Fields
+    size_t m_chunk_size       = 64 * 1024;
+    FileIo m_file_io          = FileIo::Pipeline;
+    FileFormat m_file_format  = FileFormat::Raw;
+    Method m_container_method = Method::CTR;
+    bool m_container_mac      = true;
+    bool m_container_compress = false;
+    std::shared_ptr<ThreadPool> m_pool;
+    std::array<uint32_t, 8> m_key;
+    round_keys_t m_encrypt_schedule;
+    round_keys_t m_decrypt_schedule;
+    block_t m_initialization_vector;
+    // Таблицы замены, для которых генерируется код (nullptr - генерация выключена).
+    const round_table_t* m_jit_tables = nullptr;
+    std::shared_ptr<const JitCipher> m_jit;
+};
+
+/**
+ * Шифр ГОСТ 28147-89 с набором параметров ParamSet (см. ParamSets.h).
+ *
+ * Все константные функции объекта реентерабельны: ключ, раундовые ключи и настройки
+ * только читаются, а состояние отдельной операции (состояние сцепления, счетчик,
+ * буферы) находится в локальных переменных или в объектах Context. Поэтому один
+ * объект с развернутым ключом можно использовать из многих потоков одновременно без
+ * блокировок, передавая вектор инициализации каждой операции явно. Функции настройки
+ * (rekey, setInitializationVector, set*) не должны выполняться одновременно с
+ * другими вызовами.
+ * Таблицы замены для набора параметров строятся на этапе компиляции, поэтому выбор
+ * набора не добавляет ни инициализации во время выполнения, ни косвенных обращений
+ * в раундовой функции.
+ */
+template <typename ParamSet>
+class GOST_28147_89_Basic : public GOST_28147_89_Common
+{
+public:
+    /**
+     * Конструктор класса для шифрования ГОСТ 28147-89.
+     * Инициализирует объект с заданным ключом.
+     * Ключ должен иметь размер 32 байта.
+     * @param key Указатель на символьное представление ключа.
+     */
+    GOST_28147_89_Basic(const char* key);
+
+    /**
+     * Инициализирует объект ключом, заданным произвольными 32 байтами.
+     * @param key Ключ (32 байта).
+     */
+    GOST_28147_89_Basic(std::span<const std::byte, 32> key);
+
+    /**
+     * Включает шифрование кодом x86-64, сгенерированным для ключа (JIT), для
+     * долгоживущих ключей, например ключа тома, которым шифруются терабайты.
+     * Все 32 раунда развернуты, раундовые ключи записаны в код константами, а циклы
+     * режимов ECB и CTR (и расшифрования CBC и CFB) сгенерированы вместе с ними.
+     * Код создается заново при каждом rekey, что стоит десятков микросекунд, и
+     * стирается вместе с ключом. Генерация поддерживается в x86-64 Linux и BSD; если
+     * она недоступна или ОС запрещает исполняемую память, используется общий путь.
+     * Выбирать стоит по результату измерений: векторные ядра (см. kernels) на
+     * процессорах с AVX-512 могут быть быстрее.
+     * @return true, если сгенерированный код используется.
+     */
+    bool setJit(bool enable);
+
+    void encrypt(Method method, std::istream& is, std::ostream& os) const;
+    void encryptFile(const std::string& input_filename,
+                     const std::string& output_filename = "") const;
+    void decrypt(Method method, std::istream& is, std::ostream& os) const;
+    void decryptFile(const std::string& input_filename,
+                     const std::string& output_filename = "") const;
+
+    /**
+     * Шифрует поток с вектором инициализации, заданным для этой операции, не изменяя
+     * объект (см. описание класса).
+     * @param iv - вектор инициализации (начальное значение счетчика).
+     */
+    void encrypt(Method method, const block_t& iv, std::istream& is,
+                 std::ostream& os) const;
+    void decrypt(Method method, const block_t& iv, std::istream& is,
+                 std::ostream& os) const;
+
+    /**
+     * Шифрует данные из памяти в буфер, предоставленный вызывающей стороной, без
+     * использования потоков и без выделения памяти в куче. Последний неполный блок
+     * дополняется нулями, как и при потоковой обработке.
+     * @param input - открытый текст.
+     * @param output - буфер для шифротекста размером не менее outputSize(input.size())
+     * байт; может совпадать с input.
+     * @return Количество записанных байт.
+     */
+    size_t encrypt(Method method, std::span<const std::byte> input,
+                   std::span<std::byte> output) const;
+
+    /**
+     * Расшифровывает данные из памяти в буфер, предоставленный вызывающей стороной.
+     * @param input - шифротекст.
+     * @param output - буфер для открытого текста размером не менее
+     * outputSize(input.size()) байт; может совпадать с input.
+     * @return Количество записанных байт.
+     */
+    size_t decrypt(Method method, std::span<const std::byte> input,
+                   std::span<std::byte> output) const;
+
+    /**
+     * Шифрует данные из памяти с вектором инициализации, заданным для этой операции.
+     * @param iv - вектор инициализации (начальное значение счетчика).
+     * @return Количество записанных байт.
+     */
+    size_t encrypt(Method method, const block_t& iv, std::span<const std::byte> input,
+                   std::span<std::byte> output) const;
+    size_t decrypt(Method method, const block_t& iv, std::span<const std::byte> input,
+                   std::span<std::byte> output) const;
+
+    /**
+     * Пакетно зашифровывает множество независимых сообщений, каждое со своим
+     * вектором инициализации. Результат для каждого сообщения совпадает с encrypt.
+     *
+     * В режимах CBC, CFB и OFB блоки одного сообщения зависят друг от друга и
+     * шифруются строго последовательно, поэтому короткие сообщения по одному
+     * оставляют процессор простаивать в ожидании результата каждого раунда. Здесь
+     * блоки нескольких сообщений обрабатываются вместе (в векторных регистрах AVX2
+     * или группами скалярных блоков), и скорость приближается к режиму ECB.
+     * Сообщения распределяются между потоками пула (см. setThreadCount).
+     */
+    void encryptBatch(Method method, std::span<const Message> messages) const;
+
+    /**
+     * Пакетно расшифровывает множество независимых сообщений (см. encryptBatch).
+     */
+    void decryptBatch(Method method, std::span<const Message> messages) const;
+
+    /**
+     * Зашифровывает поток и за тот же проход вырабатывает имитовставку открытого
+     * текста (режим выработки имитовставки ГОСТ 28147-89). Каждая порция данных (см.
+     * setChunkSize) учитывается в имитовставке и шифруется, пока находится в кэше,
+     * поэтому данные читаются из памяти один раз. Имитовставка вырабатывается на том
+     * же ключе, что и шифротекст.
+     * @return Имитовставка (64 бита; стандарт допускает использование первых l бит,
+     * обычно 32).
+     */
+    block_t encryptWithMac(Method method, std::istream& is, std::ostream& os) const;
+
+    /**
+     * Расшифровывает поток и за тот же проход вырабатывает имитовставку полученного
+     * открытого текста. Результат совпадает с имитовставкой encryptWithMac, если
+     * шифротекст не был изменен.
+     * @return Имитовставка открытого текста.
+     */
+    block_t decryptWithMac(Method method, std::istream& is, std::ostream& os) const;
+
+    /**
+     * Аналоги encryptWithMac и decryptWithMac для данных в памяти (см. encrypt).
+     * @param mac - имитовставка открытого текста.
+     * @return Количество записанных байт.
+     */
+    size_t encryptWithMac(Method method, std::span<const std::byte> input,
+                          std::span<std::byte> output, block_t& mac) const;
+    size_t decryptWithMac(Method method, std::span<const std::byte> input,
+                          std::span<std::byte> output, block_t& mac) const;
+
+    /**
+     * Аналоги encryptWithMac и decryptWithMac с вектором инициализации, заданным для
+     * этой операции.
+     * @param iv - вектор инициализации (начальное значение счетчика).
+     */
+    block_t encryptWithMac(Method method, const block_t& iv, std::istream& is,
+                           std::ostream& os) const;
+    block_t decryptWithMac(Method method, const block_t& iv, std::istream& is,
+                           std::ostream& os) const;
+    size_t encryptWithMac(Method method, const block_t& iv,
+                          std::span<const std::byte> input, std::span<std::byte> output,
+                          block_t& mac) const;
+    size_t decryptWithMac(Method method, const block_t& iv,
+                          std::span<const std::byte> input, std::span<std::byte> output,
+                          block_t& mac) const;
+
+    /**
+     * Вырабатывает имитовставку без шифрования, например для проверки целостности
+     * открытого текста. Последний неполный блок дополняется нулями, как при
+     * шифровании, поэтому результат совпадает с имитовставкой encryptWithMac.
+     * @return Имитовставка.
+     */
+    block_t computeMac(std::istream& is) const;
+    block_t computeMac(std::span<const std::byte> input) const;
+
+    /**
+     * Зашифровывает или расшифровывает (в режиме CTR это одна и та же операция)
+     * произвольный диапазон байт [offset, offset + input.size()) потока, начатого с
+     * текущего вектора инициализации. Значение счетчика для первого блока диапазона
+     * вычисляется сразу, поэтому стоимость не зависит от offset: например, последние
+     * 4 КиБ большого зашифрованного файла читаются без обработки предшествующих
+     * данных. Результат совпадает с соответствующим участком результата encrypt.
+     * @param offset - смещение первого байта диапазона от начала потока.
+     * @param input - данные диапазона.
+     * @param output - буфер размером не менее input.size() байт; может совпадать с
+     * input.
+     * @return Количество записанных байт (равно input.size()).
+     */
+    size_t processCounterRange(uint64_t offset, std::span<const std::byte> input,
+                               std::span<std::byte> output) const;
+
+    /**
+     * Обрабатывает диапазон потока, начатого с вектора инициализации iv (см.
+     * processCounterRange выше).
+     * @param iv - вектор инициализации (начальное значение счетчика).
+     */
+    size_t processCounterRange(const block_t& iv, uint64_t offset,
+                               std::span<const std::byte> input,
+                               std::span<std::byte> output) const;
+
+    /**
+     * Читает диапазон [offset, offset + output.size()) открытого текста из
+     * контейнера (см. FileFormat::Container). Расшифровываются только участки,
+     * содержащие диапазон, и проверяются их имитовставки. Диапазон за концом
+     * открытого текста не читается.
+     * @return Количество записанных байт.
+     */
+    size_t readContainer(const std::string& filename, uint64_t offset,
+                         std::span<std::byte> output) const;
+
+    /**
+     * Контекст пошаговой обработки сообщения, поступающего частями произвольной
+     * длины (сетевые пакеты, чтение из канала).
+     *
+     * Контекст хранит состояние сцепления (предыдущий блок или счетчик) и остаток
+     * неполного блока между вызовами update(). В режимах CFB, OFB и CTR каждый
+     * вызов update() сразу возвращает ровно столько байт, сколько получил, а длина
+     * результата совпадает с длиной сообщения. В режимах ECB и CBC возвращаются
+     * только полные блоки, а final() дополняет остаток нулями.
+     *
+     * Контекст ссылается на объект шифра, который должен существовать до окончания
+     * обработки, и не изменяет его, поэтому с одним шифром могут одновременно
+     * работать контексты разных потоков. Начальное состояние берется из вектора
+     * инициализации шифра или задается явно.
+     */
+    class Context
+    {
+    public:
+        Context(const GOST_28147_89_Basic& cipher, Method method, bool isEncrypting);
+        Context(const GOST_28147_89_Basic& cipher, Method method, bool isEncrypting,
+                const block_t& iv);
+
+        /**
+         * Обрабатывает очередную часть сообщения.
+         * @param input - часть сообщения произвольной длины.
+         * @param output - буфер размером не менее input.size() + 8 байт.
+         * @return Количество записанных байт.
+         */
+        size_t update(std::span<const std::byte> input, std::span<std::byte> output);
+
+        /**
+         * Завершает обработку сообщения. В режимах ECB и CBC обрабатывает остаток
+         * неполного блока, дополненный нулями; пустое сообщение, как и в encrypt,
+         * дает один блок из нулей.
+         * @param output - буфер размером не менее 8 байт.
+         * @return Количество записанных байт (0 или 8).
+         */
+        size_t final(std::span<std::byte> output);
+
+    private:
+        /**
+         * @return true для режимов, не требующих дополнения (CFB, OFB, CTR).
+         */
+        bool isStreamMode() const;
+
+        /**
+         * Вычисляет гамму для очередного блока в режимах CFB, OFB и CTR.
+         */
+        void nextGamma();
+
+        const GOST_28147_89_Basic& m_cipher;
+        Method m_method;
+        bool m_encrypt;
+        block_t m_prev;
+        // Накопленные байты текущего неполного блока: открытый текст (ECB, CBC) или
+        // шифротекст для обратной связи (CFB).
+        block_t m_block;
+        block_t m_gamma;
+        size_t m_position = 0;
+        // Сообщение пусто: update не получал данных.
+        bool m_empty = true;
+    };
+
+    /**
+     * Заранее вычисленная гамма для режимов OFB и CTR.
+     *
+     * В этих режимах гамма не зависит от данных, поэтому ее можно выработать до их
+     * поступления: в фоновом потоке или в паузах между сообщениями (prefill). Тогда
+     * при поступлении данных шифрование сводится к наложению гаммы операцией XOR, и
+     * стоимость шифра не входит в задержку обработки запроса.
+     *
+     * Гамма накапливается в кольцевом буфере ограниченного размера, начиная с
+     * вектора инициализации шифра; результат совпадает с encrypt/decrypt в том же
+     * режиме (без дополнения последнего блока). Объект шифра должен существовать до
+     * уничтожения объекта Keystream.
+     */
+    class Keystream
+    {
+    public:
+        /**
+         * @param method - режим OFB или CTR.
+         * @param capacity - размер буфера гаммы в байтах (округляется вверх до целого
+         * числа порций по 512 байт).
+         * @param background - вырабатывать гамму в фоновом потоке; иначе гамма
+         * вырабатывается вызовами prefill и, при нехватке, в apply.
+         */
+        Keystream(const GOST_28147_89_Basic& cipher, Method method,
+                  size_t capacity = 64 * 1024, bool background = true);
+
+        /**
+         * Начинает гамму с вектора инициализации iv вместо вектора шифра.
+         * @param iv - вектор инициализации (начальное значение счетчика).
+         */
+        Keystream(const GOST_28147_89_Basic& cipher, Method method, const block_t& iv,
+                  size_t capacity = 64 * 1024, bool background = true);
+        ~Keystream();
+
+        Keystream(const Keystream&)            = delete;
+        Keystream& operator=(const Keystream&) = delete;
+
+        /**
+         * Накладывает гамму на очередную часть сообщения (зашифрование и
+         * расшифрование совпадают).
+         * @param input - часть сообщения произвольной длины.
+         * @param output - буфер размером не менее input.size() байт; может совпадать
+         * с input.
+         * @return Количество записанных байт (равно input.size()).
+         */
+        size_t apply(std::span<const std::byte> input, std::span<std::byte> output);
+
+        /**
+         * Заполняет буфер гаммы в вызывающем потоке, например в паузах между
+         * сообщениями. При работе с фоновым потоком ничего не делает.
+         */
+        void prefill();
+
+    private:
+        /**
+         * Вырабатывает очередную порцию гаммы, если в буфере есть место.
+         * @return false, если буфер заполнен.
+         */
+        bool generate();
+
+        void producerLoop();
+
+        const GOST_28147_89_Basic& m_cipher;
+        Method m_method;
+        // Состояние выработки гаммы (значение обратной связи или счетчик).
+        block_t m_prev;
+        std::vector<byte_t> m_buffer;
+        // Начало и количество готовых байт гаммы в кольцевом буфере.
+        size_t m_head = 0;
+        size_t m_size = 0;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stop = false;
+        // Исключение фонового потока (например, переполнение счетчика).
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
+
+private:
+    /**
+     * Таблицы замены, построенные из S-блоков набора параметров на этапе компиляции.
+     */
+    static constexpr round_table_t m_round_tables = buildRoundTables(ParamSet::s_blocks);
+
+    /**
+     * Состояние выработки имитовставки: текущее значение и количество учтенных
+     * блоков.
+     */
+    struct MacState
+    {
+        block_t value  = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        uint64_t count = 0;
+    };
+
+    /**
+     * @param iv - начальное состояние сцепления (вектор инициализации).
+     * @param mac - состояние имитовставки открытого текста или nullptr.
+     */
+    void processStream(Method method, const block_t& iv, std::istream& is,
+                       std::ostream& os, bool isEncrypting,
+                       MacState* mac = nullptr) const;
+
+    size_t processBuffer(Method method, const block_t& iv,
+                         std::span<const std::byte> input, std::span<std::byte> output,
+                         bool isEncrypting, MacState* mac = nullptr) const;
+
+    /**
+     * Количество блоков гаммы, вырабатываемых Keystream за один раз.
+     */
+    static constexpr size_t KEYSTREAM_PORTION = 64;
+
+    /**
+     * Количество сообщений пакета, продвигаемых на один блок за шаг: несколько
+     * векторов AVX2, чтобы накладные расходы на сбор блоков окупались.
+     */
+    static constexpr size_t BATCH_LANES = 32;
+
+    /**
+     * Проверяет буферы пакета и распределяет сообщения между потоками пула.
+     */
+    void processBatch(Method method, bool isEncrypting,
+                      std::span<const Message> messages) const;
+
+    /**
+     * Обрабатывает сообщения, одновременно продвигая до BATCH_LANES из них на один
+     * блок за шаг.
+     */
+    void processLanes(Method method, bool isEncrypting,
+                      std::span<const Message> messages) const;
+
+    /**
+     * Функция шифрования участков контейнера.
+     */
+    ChunkCipher containerCipher(bool isEncrypting) const;
+
+    /**
+     * Обрабатывает файл в режиме CTR способом, заданным setFileIo.
+     */
+    void processFile(const std::string& input_filename,
+                     const std::string& output_filename, bool isEncrypting) const;
+
+    /**
+     * Учитывает блоки открытого текста в имитовставке.
+     * @param data - блоки данных (count * 8 байт).
+     */
+    void updateMac(MacState& mac, const byte_t* data, size_t count) const;
+
+    /**
+     * Завершает выработку имитовставки. Сообщение из одного блока дополняется
+     * нулевым блоком, так как стандарт требует не менее двух блоков.
+     */
+    block_t finalMac(MacState& mac) const;
+
+    /**
+     * Последовательно обрабатывает блоки данных.
+     * @param in - входные данные (count * 8 байт).
+     * @param out - выходные данные (может совпадать с in).
+     * @param count - количество блоков.
+     * @param prev - состояние сцепления (предыдущий блок или счетчик); обновляется.
+     */
+    void processBlocks(Method method, bool isEncrypting, const byte_t* in, byte_t* out,
+                       size_t count, block_t& prev) const;
+
+    /**
+     * Обрабатывает порцию блоков, распределяя ее между потоками пула, если режим это
+     * допускает, иначе последовательно.
+     */
+    void processChunk(Method method, bool isEncrypting, const byte_t* in, byte_t* out,
+                      size_t count, block_t& prev) const;
+
+    /**
+     * Применяет S-блоки и циклический сдвиг к 32-битному числу и ключу.
+     * @param A - 32-битная половина блока.
      * @param key - часть ключа.
      * @return Результат применения S-блоков.
      */
-    uint32_t f(const std::array<byte_t, 4>& A, const uint32_t& key);
+    inline uint32_t f(const uint32_t A, const uint32_t key) const;
 
     /**
      * Применяет функцию шифрования (основную на сети Фейстеля) к блоку текста.
-     * @param __key - ключ шифрования.
+     * @param schedule - последовательность из 32 раундовых ключей.
      * @param text_block - блок текста.
      * @return Зашифрованный блок.
      */
-    block_t block_cipher(const std::array<uint32_t, 8>& __key, const block_t& text_block);
+    block_t block_cipher(const round_keys_t& schedule, const block_t& text_block) const;
 
     /**
-     * Данная функция принимает структуру данных `block_t` и увеличивает его значение на
-     * единицу.
-     * @param block - число, которое необходимо инкрементировать.
-     * @return Новый экземпляр представляющий инкрементированное значение.
+     * Применяет к блоку цикл 16-З: первые 16 раундов шифрования без завершающей
+     * перестановки половин блока (используется при выработке имитовставки).
+     * @param text_block - блок текста.
+     * @return Преобразованный блок.
      */
-    block_t incrementCounter(const block_t& block);
+    block_t mac_cycle(const block_t& text_block) const;
 
-    // Private Fields
-    std::istream* m_stream;
-    std::array<uint32_t, 8> m_key;
-    block_t m_initialization_vector;
+    /**
+     * Применяет функцию шифрования к последовательности независимых блоков ядром,
+     * выбранным для процессора (см. kernels).
+     * @param schedule - последовательность из 32 раундовых ключей.
+     * @param in - входные блоки (count * 8 байт).
+     * @param out - выходные блоки (может совпадать с in).
+     * @param count - количество блоков.
+     */
+    void block_cipher_multi(const round_keys_t& schedule, const byte_t* in, byte_t* out,
+                            size_t count) const;
 };
 
-#endif // !GOST_28147_89_H
+/**
+ * Шифр с набором параметров по умолчанию (id-Gost28147-89-CryptoPro-A-ParamSet).
+ */
+using GOST_28147_89 = GOST_28147_89_Basic<CryptoPro_A_ParamSet>;
+
+// Реализация находится в GOST_28147_89.cpp и инстанцирована для всех наборов
+// параметров из ParamSets.h.
+extern template class GOST_28147_89_Basic<CryptoPro_A_ParamSet>;
+extern template class GOST_28147_89_Basic<CryptoPro_B_ParamSet>;
+extern template class GOST_28147_89_Basic<CryptoPro_C_ParamSet>;
+extern template class GOST_28147_89_Basic<CryptoPro_D_ParamSet>;
+extern template class GOST_28147_89_Basic<TC26_Z_ParamSet>;
 
 template <size_t S>
-inline std::array<GOST_28147_89::byte_t, S>
-operator^(const std::array<GOST_28147_89::byte_t, S>& left,
-          const std::array<GOST_28147_89::byte_t, S>& right)
+inline std::array<GOST_28147_89_Common::byte_t, S>
+operator^(const std::array<GOST_28147_89_Common::byte_t, S>& left,
+          const std::array<GOST_28147_89_Common::byte_t, S>& right)
 {
-    std::array<GOST_28147_89::byte_t, S> result;
+    std::array<GOST_28147_89_Common::byte_t, S> result;
     for (size_t i = 0; i < S; ++i)
         result[i] = left[i] ^ right[i];
     return result;
-}
\ No newline at end of file
+}
+
+#endif // !GOST_28147_89_H
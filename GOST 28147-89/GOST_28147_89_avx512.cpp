@@ -0,0 +1,131 @@
+﻿#include "GOST_28147_89.h"
+
+// Векторное ядро шифрования на AVX-512F.
+// Шестнадцать блоков обрабатываются одновременно: половины блоков раскладываются по
+// 32-битным элементам двух 512-битных регистров, а выборки из таблиц замены
+// выполняются командой gather. Используются только команды AVX-512F, поэтому
+// перестановка байт выполняется циклическими сдвигами, а не vpshufb (AVX-512BW).
+// Как и ядро AVX2, файл компилируется без специальных флагов.
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// GCC 12 ложно предупреждает о неинициализированной переменной внутри
+// avx512fintrin.h (_mm512_undefined_epi32) при -Wall.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define GOST_TARGET_AVX512
+#else
+#define GOST_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+bool GOST_28147_89_Common::hasAvx512()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    // CPUID.(EAX=7, ECX=0):EBX[16] - AVX-512F; ОС должна сохранять регистры YMM,
+    // ZMM и регистры масок (биты 1, 2, 5, 6, 7 регистра XCR0).
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0xE6) != 0xE6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 16)) != 0;
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+namespace
+{
+    /**
+     * Переставляет байты каждого 32-битного элемента (big-endian <-> native).
+     */
+    GOST_TARGET_AVX512
+    inline __m512i byteSwap(__m512i x)
+    {
+        return _mm512_or_si512(
+            _mm512_and_si512(_mm512_rol_epi32(x, 8), _mm512_set1_epi32(0x00FF00FF)),
+            _mm512_and_si512(_mm512_rol_epi32(x, 24),
+                             _mm512_set1_epi32(static_cast<int>(0xFF00FF00))));
+    }
+} // namespace
+
+GOST_TARGET_AVX512
+size_t GOST_28147_89_Common::block_cipher_avx512(const round_table_t& tables,
+                                                 const round_keys_t& schedule,
+                                                 const byte_t* in, byte_t* out,
+                                                 size_t count)
+{
+    // Элементы 0 - 15 - первый регистр, 16 - 31 - второй:
+    // [B0 A0 ... B7 A7] [B8 A8 ... B15 A15] -> [B0 ... B15] и [A0 ... A15].
+    const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24,
+                                           26, 28, 30);
+    const __m512i odd  = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25,
+                                           27, 29, 31);
+    // [A0 ... A15] и [B0 ... B15] -> [A0 B0 ... A7 B7] [A8 B8 ... A15 B15].
+    const __m512i merge_lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21,
+                                               6, 22, 7, 23);
+    const __m512i merge_hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13,
+                                               29, 14, 30, 15, 31);
+    const __m512i mask     = _mm512_set1_epi32(0xFF);
+
+    const int* T0 = reinterpret_cast<const int*>(tables[0].data());
+    const int* T1 = reinterpret_cast<const int*>(tables[1].data());
+    const int* T2 = reinterpret_cast<const int*>(tables[2].data());
+    const int* T3 = reinterpret_cast<const int*>(tables[3].data());
+
+    const size_t vector_count = count & ~size_t(15);
+    for (size_t i = 0; i < vector_count; i += 16) {
+        const __m512i lo = byteSwap(_mm512_loadu_si512(in + i * 8));
+        const __m512i hi = byteSwap(_mm512_loadu_si512(in + i * 8 + 64));
+
+        __m512i B = _mm512_permutex2var_epi32(lo, even, hi);
+        __m512i A = _mm512_permutex2var_epi32(lo, odd, hi);
+
+        for (size_t r = 0; r < 32; ++r) {
+            const __m512i x =
+                _mm512_add_epi32(A, _mm512_set1_epi32(static_cast<int>(schedule[r])));
+            __m512i t = _mm512_i32gather_epi32(_mm512_and_si512(x, mask), T0, 4);
+            t         = _mm512_xor_si512(
+                t, _mm512_i32gather_epi32(
+                       _mm512_and_si512(_mm512_srli_epi32(x, 8), mask), T1, 4));
+            t = _mm512_xor_si512(
+                t, _mm512_i32gather_epi32(
+                       _mm512_and_si512(_mm512_srli_epi32(x, 16), mask), T2, 4));
+            t = _mm512_xor_si512(t,
+                                 _mm512_i32gather_epi32(_mm512_srli_epi32(x, 24), T3, 4));
+
+            const __m512i B_bits = _mm512_xor_si512(B, t);
+            B                    = A;
+            A                    = B_bits;
+        }
+
+        // Выходной блок - A || B, как и в скалярной реализации.
+        _mm512_storeu_si512(out + i * 8,
+                            byteSwap(_mm512_permutex2var_epi32(A, merge_lo, B)));
+        _mm512_storeu_si512(out + i * 8 + 64,
+                            byteSwap(_mm512_permutex2var_epi32(A, merge_hi, B)));
+    }
+    return vector_count;
+}
+
+#else
+
+bool GOST_28147_89_Common::hasAvx512() { return false; }
+
+size_t GOST_28147_89_Common::block_cipher_avx512(const round_table_t&,
+                                                 const round_keys_t&, const byte_t*,
+                                                 byte_t*, size_t)
+{
+    return 0;
+}
+
+#endif
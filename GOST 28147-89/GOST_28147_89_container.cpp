@@ -0,0 +1,625 @@
+﻿#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "GOST_28147_89.h"
+#include "Lz4.h"
+#include "ThreadPool.h"
+
+// Формат контейнера (FileFormat::Container). Все числа записываются в порядке от
+// старшего байта к младшему.
+//
+// Заголовок (32 байта):
+//     0   "G89C"
+//     4   версия формата (1)
+//     5   режим шифрования (Method)
+//     6   идентификатор набора параметров (ParamSets.h)
+//     7   флаги: бит 0 - участки содержат имитовставку, бит 1 - участки сжимаются
+//     8   размер участка открытого текста (4 байта, кратен 8)
+//     12  проверочное значение ключа (4 байта, см. keyCheckValue)
+//     16  вектор инициализации (8 байт)
+//     24  длина открытого текста (8 байт)
+// Участки (все, кроме последнего, полного размера):
+//     0   вектор инициализации участка (8 байт)
+//     8   длина открытого текста участка (4 байта)
+//     12  длина сжатых данных (4 байта, 0 - участок не сжат)
+//     16  шифротекст открытого текста или сжатых данных (LZ4), дополненный до
+//         целого блока
+//         имитовставка (8 байт), если задан флаг: вырабатывается по заголовку
+//         контейнера, вектору инициализации и длине данных участка и открытому
+//         тексту участка или сжатым данным
+// Оглавление: для каждого участка смещение (8 байт), длина (4 байта) и длина сжатых
+// данных (4 байта), затем завершение (24 байта): смещение оглавления (8 байт),
+// количество участков (8 байт), "G89I" и резерв (4 байта).
+//
+// Без сжатия участки полного размера имеют одинаковую длину, поэтому по длине
+// прерванного файла без оглавления видно, сколько участков записано полностью. Со
+// сжатием записи имеют разную длину: читатель берет их смещения из оглавления, а
+// продолжение записи просматривает записи по порядку. Участок сохраняется сжатым,
+// только если это его уменьшает.
+//
+// Продолжение записи предполагает, что входной файл не менялся с начала прерванной
+// записи: проверяются только его длина (в заголовке) и время изменения, которое не
+// должно быть позже времени изменения контейнера.
+
+namespace
+{
+    constexpr char CONTAINER_MAGIC[4] = { 'G', '8', '9', 'C' };
+    constexpr char INDEX_MAGIC[4]     = { 'G', '8', '9', 'I' };
+    constexpr unsigned char CONTAINER_VERSION = 1;
+    constexpr unsigned char FLAG_MAC          = 1;
+    constexpr unsigned char FLAG_COMPRESSED   = 2;
+
+    constexpr size_t HEADER_SIZE       = 32;
+    constexpr size_t CHUNK_HEADER_SIZE = 16;
+    constexpr size_t MAC_SIZE          = 8;
+    constexpr size_t INDEX_ENTRY_SIZE  = 16;
+    constexpr size_t TRAILER_SIZE      = 24;
+
+    using Method  = GOST_28147_89_Common::Method;
+    using block_t = GOST_28147_89_Common::block_t;
+
+    void store(std::byte* data, uint64_t value, size_t size)
+    {
+        for (size_t i = size; i-- > 0; value >>= 8)
+            data[i] = static_cast<std::byte>(value);
+    }
+
+    uint64_t load(const std::byte* data, size_t size)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i)
+            value = value << 8 | static_cast<uint64_t>(data[i]);
+        return value;
+    }
+
+    /**
+     * Заголовок контейнера и расположение участков.
+     */
+    struct Header
+    {
+        unsigned char method    = 0;
+        unsigned char param_set = 0;
+        unsigned char flags     = 0;
+        uint32_t chunk_size     = 0;
+        uint32_t key_check      = 0;
+        block_t iv {};
+        uint64_t length = 0;
+
+        bool operator==(const Header&) const = default;
+
+        bool mac() const { return (flags & FLAG_MAC) != 0; }
+
+        bool compressed() const { return (flags & FLAG_COMPRESSED) != 0; }
+
+        uint64_t chunkCount() const { return (length + chunk_size - 1) / chunk_size; }
+
+        size_t chunkLength(uint64_t chunk) const
+        {
+            return static_cast<size_t>(std::min<uint64_t>(
+                chunk_size, length - chunk * chunk_size));
+        }
+
+        /**
+         * @param payload - длина зашифрованных данных участка: открытого текста или
+         * сжатых данных.
+         */
+        size_t recordSize(size_t payload) const
+        {
+            return CHUNK_HEADER_SIZE + GOST_28147_89_Common::outputSize(payload)
+                   + (mac() ? MAC_SIZE : 0);
+        }
+
+        // Расположение участков и оглавления контейнера без сжатия.
+
+        uint64_t recordOffset(uint64_t chunk) const
+        {
+            return HEADER_SIZE + chunk * recordSize(chunk_size);
+        }
+
+        uint64_t indexOffset() const
+        {
+            const uint64_t count = chunkCount();
+            return count == 0 ? HEADER_SIZE
+                              : recordOffset(count - 1)
+                                    + recordSize(chunkLength(count - 1));
+        }
+
+        uint64_t fileSize() const
+        {
+            return indexOffset() + chunkCount() * INDEX_ENTRY_SIZE + TRAILER_SIZE;
+        }
+
+        std::array<std::byte, HEADER_SIZE> encode() const
+        {
+            std::array<std::byte, HEADER_SIZE> data {};
+            std::memcpy(data.data(), CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+            data[4] = static_cast<std::byte>(CONTAINER_VERSION);
+            data[5] = static_cast<std::byte>(method);
+            data[6] = static_cast<std::byte>(param_set);
+            data[7] = static_cast<std::byte>(flags);
+            store(&data[8], chunk_size, 4);
+            store(&data[12], key_check, 4);
+            std::memcpy(&data[16], iv.data(), iv.size());
+            store(&data[24], length, 8);
+            return data;
+        }
+
+        /**
+         * @return false, если данные не являются заголовком контейнера.
+         */
+        bool decode(const std::array<std::byte, HEADER_SIZE>& data)
+        {
+            if (std::memcmp(data.data(), CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0
+                || data[4] != static_cast<std::byte>(CONTAINER_VERSION))
+                return false;
+            method     = static_cast<unsigned char>(data[5]);
+            param_set  = static_cast<unsigned char>(data[6]);
+            flags      = static_cast<unsigned char>(data[7]);
+            chunk_size = static_cast<uint32_t>(load(&data[8], 4));
+            key_check  = static_cast<uint32_t>(load(&data[12], 4));
+            std::memcpy(iv.data(), &data[16], iv.size());
+            length = load(&data[24], 8);
+            return method < GOST_28147_89_Common::METHOD_COUNT && chunk_size != 0
+                   && chunk_size % 8 == 0;
+        }
+    };
+
+    /**
+     * Проверочное значение ключа: первые 4 байта имитовставки пустого участка с
+     * нулевым вектором инициализации. В отличие от E_K(0) оно не совпадает с гаммой
+     * режимов CTR и OFB и не раскрывает данные участков.
+     */
+    template <typename ChunkCipher>
+    uint32_t keyCheckValue(const ChunkCipher& cipher)
+    {
+        block_t mac;
+        cipher(Method::ECB, block_t {}, 0, {}, {}, {}, &mac);
+        return static_cast<uint32_t>(load(reinterpret_cast<std::byte*>(mac.data()), 4));
+    }
+
+    bool readHeader(std::istream& is, Header& header)
+    {
+        std::array<std::byte, HEADER_SIZE> data;
+        return is.read(reinterpret_cast<char*>(data.data()), data.size())
+               && header.decode(data);
+    }
+
+    /**
+     * @return true, если в конце файла есть завершение оглавления, согласованное с
+     * заголовком.
+     */
+    bool hasIndex(std::istream& is, const Header& header, uint64_t file_size)
+    {
+        const uint64_t count = header.chunkCount();
+        if (header.compressed() ? file_size < HEADER_SIZE + count * INDEX_ENTRY_SIZE
+                                                  + TRAILER_SIZE
+                                : file_size != header.fileSize())
+            return false;
+
+        // Оглавление занимает место непосредственно перед завершением.
+        const uint64_t index = file_size - TRAILER_SIZE - count * INDEX_ENTRY_SIZE;
+        std::array<std::byte, TRAILER_SIZE> trailer;
+        is.clear();
+        is.seekg(static_cast<std::streamoff>(file_size - TRAILER_SIZE));
+        return is.read(reinterpret_cast<char*>(trailer.data()), trailer.size())
+               && load(&trailer[0], 8) == index && load(&trailer[8], 8) == count
+               && std::memcmp(&trailer[16], INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0;
+    }
+
+    /**
+     * Открытый для чтения полный контейнер: заголовок и оглавление.
+     */
+    struct Container
+    {
+        std::ifstream file;
+        Header header;
+        std::vector<uint64_t> offsets;
+        // Длины сжатых данных участков (0 - участок не сжат).
+        std::vector<uint32_t> packed;
+
+        /**
+         * @return Длина зашифрованных данных участка.
+         */
+        size_t payload(uint64_t chunk) const
+        {
+            return packed[chunk] == 0 ? header.chunkLength(chunk) : packed[chunk];
+        }
+    };
+
+    /**
+     * Открывает контейнер и проверяет его заголовок и оглавление.
+     * @param require_mac - отвергать контейнер без имитовставок: флаг в заголовке
+     * не должен отключать проверку, которую ожидает вызывающая сторона.
+     */
+    template <typename ChunkCipher>
+    void openContainer(Container& container, const std::string& filename,
+                       unsigned char param_set, const ChunkCipher& cipher,
+                       bool require_mac)
+    {
+        container.file.open(filename, std::ios::binary);
+        if (!container.file)
+            throw std::runtime_error("Failed to open input file.");
+        Header& header = container.header;
+        if (!readHeader(container.file, header))
+            throw std::runtime_error("File is not a GOST 28147-89 container.");
+        if (header.param_set != param_set)
+            throw std::runtime_error("Container was written with another parameter set.");
+        if (header.key_check != keyCheckValue(cipher))
+            throw std::runtime_error("Container was written with another key.");
+        if (require_mac && !header.mac())
+            throw std::runtime_error("Container has no MAC.");
+        if (!hasIndex(container.file, header, std::filesystem::file_size(filename)))
+            throw std::runtime_error("Container is incomplete.");
+
+        const uint64_t count = header.chunkCount();
+        const uint64_t index_offset = std::filesystem::file_size(filename) - TRAILER_SIZE
+                                      - count * INDEX_ENTRY_SIZE;
+        std::vector<std::byte> index(count * INDEX_ENTRY_SIZE);
+        container.file.clear();
+        container.file.seekg(static_cast<std::streamoff>(index_offset));
+        if (!container.file.read(reinterpret_cast<char*>(index.data()),
+                                 static_cast<std::streamsize>(index.size())))
+            throw std::runtime_error("Failed to read container index.");
+        container.offsets.resize(count);
+        container.packed.resize(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            const std::byte* entry = &index[i * INDEX_ENTRY_SIZE];
+            container.offsets[i]   = load(entry, 8);
+            container.packed[i]    = static_cast<uint32_t>(load(entry + 12, 4));
+            // Запись участка должна находиться между заголовком и оглавлением.
+            if (load(entry + 8, 4) != header.chunkLength(i)
+                || container.packed[i] >= header.chunkLength(i)
+                || (container.packed[i] != 0 && !header.compressed())
+                || container.offsets[i] < HEADER_SIZE
+                || container.offsets[i] > index_offset
+                || index_offset - container.offsets[i]
+                       < header.recordSize(container.payload(i)))
+                throw std::runtime_error("Container index is corrupted.");
+        }
+    }
+
+    /**
+     * Читает запись участка по смещению из оглавления.
+     */
+    void readRecord(Container& container, uint64_t chunk, std::vector<std::byte>& record)
+    {
+        record.resize(container.header.recordSize(container.payload(chunk)));
+        container.file.seekg(static_cast<std::streamoff>(container.offsets[chunk]));
+        if (!container.file.read(reinterpret_cast<char*>(record.data()),
+                                 static_cast<std::streamsize>(record.size())))
+            throw std::runtime_error("Failed to read container chunk.");
+    }
+
+    /**
+     * Проверяет заголовок записи участка и расшифровывает его вместе с дополнением.
+     * Сжатые данные расшифровываются на месте (в record) и распаковываются в plain.
+     * @param iv - ожидаемый вектор инициализации участка.
+     * @param packed - длина сжатых данных участка по оглавлению.
+     * @throw std::runtime_error - запись не относится к участку, не совпадает
+     * имитовставка или сжатые данные повреждены.
+     */
+    template <typename ChunkCipher>
+    void decryptRecord(const Header& header, uint64_t chunk, const block_t& iv,
+                       size_t packed, std::vector<std::byte>& record,
+                       std::vector<std::byte>& plain, const ChunkCipher& cipher)
+    {
+        const size_t length  = header.chunkLength(chunk);
+        const size_t payload = packed == 0 ? length : packed;
+        const size_t size    = GOST_28147_89_Common::outputSize(payload);
+        std::byte* encrypted = record.data() + CHUNK_HEADER_SIZE;
+        if (std::memcmp(record.data(), iv.data(), iv.size()) != 0
+            || load(record.data() + 8, 4) != length
+            || load(record.data() + 12, 4) != packed)
+            throw std::runtime_error("Container chunk header is corrupted.");
+
+        plain.resize(GOST_28147_89_Common::outputSize(length));
+        const std::span<std::byte> output =
+            packed == 0 ? std::span<std::byte>(plain) : std::span(encrypted, size);
+        block_t mac;
+        const auto encoded = header.encode();
+        cipher(static_cast<Method>(header.method), iv, payload, encoded,
+               { encrypted, size }, output, header.mac() ? &mac : nullptr);
+        if (header.mac() && std::memcmp(mac.data(), encrypted + size, MAC_SIZE) != 0)
+            throw std::runtime_error("Container chunk MAC mismatch.");
+        if (packed != 0
+            && !Lz4::decompress({ encrypted, packed }, { plain.data(), length }))
+            throw std::runtime_error("Container chunk is corrupted.");
+    }
+} // namespace
+
+void GOST_28147_89_Common::setFileFormat(FileFormat file_format, Method method, bool mac,
+                                         bool compress)
+{
+    m_file_format        = file_format;
+    m_container_method   = method;
+    m_container_mac      = mac;
+    m_container_compress = compress;
+}
+
+void GOST_28147_89_Common::writeContainer(const std::string& input_filename,
+                                          const std::string& output_filename,
+                                          unsigned char param_set,
+                                          const ChunkCipher& cipher) const
+{
+    std::error_code error;
+    if (std::filesystem::equivalent(input_filename, output_filename, error))
+        throw std::invalid_argument("Container cannot overwrite its input file.");
+    if (m_chunk_size > UINT32_MAX)
+        throw std::length_error("Chunk size is too large for a container.");
+
+    std::ifstream input(input_filename, std::ios::binary);
+    if (!input)
+        throw std::runtime_error("Failed to open input file.");
+
+    Header header;
+    header.method     = static_cast<unsigned char>(m_container_method);
+    header.param_set  = param_set;
+    header.flags      = (m_container_mac ? FLAG_MAC : 0)
+                   | (m_container_compress ? FLAG_COMPRESSED : 0);
+    header.chunk_size = static_cast<uint32_t>(m_chunk_size);
+    header.key_check  = keyCheckValue(cipher);
+    header.iv         = m_initialization_vector;
+    header.length     = std::filesystem::file_size(input_filename);
+    const uint64_t count = header.chunkCount();
+
+    // Векторы инициализации участков не пересекаются: в режиме CTR участки
+    // используют те же значения счетчика, что и сплошной шифротекст файла.
+    auto nonce = [&](uint64_t chunk)
+    { return advanceCounter(header.iv, chunk * (header.chunk_size / 8)); };
+
+    // Смещения записей и длины сжатых данных записанных участков для оглавления.
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> packed;
+    uint64_t position = HEADER_SIZE;
+
+    // Прерванная запись с тем же заголовком (в том числе ключом) продолжается после
+    // последнего полностью записанного участка полного размера; неполный последний
+    // участок записывается заново. При длине, кратной размеру участка, могут
+    // сохраниться все участки, и тогда дописываются только оглавление и концевик.
+    // Входной файл, измененный после записи, шифруется заново целиком.
+    uint64_t done = 0;
+    {
+        std::ifstream existing(output_filename, std::ios::binary);
+        Header written;
+        if (existing && readHeader(existing, written) && written == header
+            && std::filesystem::last_write_time(input_filename)
+                   <= std::filesystem::last_write_time(output_filename)
+            && !hasIndex(existing, header,
+                         std::filesystem::file_size(output_filename))) {
+            const uint64_t size  = std::filesystem::file_size(output_filename);
+            const uint64_t limit = header.length / header.chunk_size;
+            existing.clear();
+            if (header.compressed()) {
+                // Записи просматриваются по порядку до первой неполной или не
+                // относящейся к своему участку.
+                std::array<std::byte, CHUNK_HEADER_SIZE> record;
+                while (done < limit
+                       && existing.seekg(static_cast<std::streamoff>(position))
+                       && existing.read(reinterpret_cast<char*>(record.data()),
+                                        record.size())) {
+                    const block_t iv      = nonce(done);
+                    const uint32_t length = static_cast<uint32_t>(load(&record[12], 4));
+                    const uint64_t end =
+                        position
+                        + header.recordSize(length == 0 ? header.chunk_size : length);
+                    if (std::memcmp(record.data(), iv.data(), iv.size()) != 0
+                        || load(&record[8], 4) != header.chunk_size
+                        || length >= header.chunk_size || end > size)
+                        break;
+                    offsets.push_back(position);
+                    packed.push_back(length);
+                    position = end;
+                    ++done;
+                }
+            } else {
+                const uint64_t record = header.recordSize(header.chunk_size);
+                done = std::min((size - HEADER_SIZE) / record, limit);
+
+                // Запись последнего сохраненного участка должна относиться к нему.
+                block_t stored;
+                if (done > 0
+                    && (!existing.seekg(
+                            static_cast<std::streamoff>(header.recordOffset(done - 1)))
+                        || !existing.read(reinterpret_cast<char*>(stored.data()), 8)
+                        || stored != nonce(done - 1)))
+                    done = 0;
+                for (uint64_t i = 0; i < done; ++i)
+                    offsets.push_back(header.recordOffset(i));
+                packed.assign(done, 0);
+                position = header.recordOffset(done);
+            }
+        }
+    }
+
+    std::ofstream output;
+    if (done == 0) {
+        offsets.clear();
+        packed.clear();
+        position = HEADER_SIZE;
+        output.open(output_filename, std::ios::binary | std::ios::trunc);
+        const auto data = header.encode();
+        output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    } else {
+        std::filesystem::resize_file(output_filename, position);
+        output.open(output_filename, std::ios::binary | std::ios::app);
+    }
+    if (!output)
+        throw std::runtime_error("Failed to open output file.");
+
+    // Участки читаются и записываются по порядку, а шифруются группами по одному на
+    // поток. После каждой группы данные сбрасываются на диск, чтобы сбой терял не
+    // больше одной группы.
+    const size_t group = m_pool ? m_pool->size() : 1;
+    const auto encoded = header.encode();
+    std::vector<std::vector<std::byte>> plain(group), compressed(group), records(group);
+    std::vector<uint32_t> lengths(group);
+    input.seekg(static_cast<std::streamoff>(done * header.chunk_size));
+    for (uint64_t first = done; first < count; first += group) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(group, count - first));
+        for (size_t i = 0; i < n; ++i) {
+            const size_t length = header.chunkLength(first + i);
+            plain[i].resize(length);
+            if (!input.read(reinterpret_cast<char*>(plain[i].data()),
+                            static_cast<std::streamsize>(length)))
+                throw std::runtime_error("Failed to read input file.");
+        }
+
+        auto process = [&](size_t i)
+        {
+            // Сжатые данные, не меньшие открытого текста, не сохраняются.
+            const size_t length = plain[i].size();
+            size_t packed_size  = 0;
+            if (header.compressed()) {
+                compressed[i].resize(length);
+                packed_size =
+                    Lz4::compress(plain[i], { compressed[i].data(), length - 1 });
+            }
+            const std::span<const std::byte> payload =
+                packed_size == 0 ? std::span<const std::byte>(plain[i])
+                                 : std::span<const std::byte>(compressed[i].data(),
+                                                              packed_size);
+            lengths[i] = static_cast<uint32_t>(packed_size);
+
+            const block_t iv = nonce(first + i);
+            records[i].resize(header.recordSize(payload.size()));
+            std::byte* record    = records[i].data();
+            std::byte* encrypted = record + CHUNK_HEADER_SIZE;
+            std::memcpy(record, iv.data(), iv.size());
+            store(record + 8, length, 4);
+            store(record + 12, packed_size, 4);
+
+            const size_t size = outputSize(payload.size());
+            block_t mac;
+            cipher(m_container_method, iv, payload.size(), encoded, payload,
+                   { encrypted, size }, header.mac() ? &mac : nullptr);
+            if (header.mac())
+                std::memcpy(encrypted + size, mac.data(), mac.size());
+        };
+        if (m_pool)
+            m_pool->parallelFor(n, process);
+        else
+            process(0);
+
+        for (size_t i = 0; i < n; ++i) {
+            offsets.push_back(position);
+            packed.push_back(lengths[i]);
+            position += records[i].size();
+            output.write(reinterpret_cast<const char*>(records[i].data()),
+                         static_cast<std::streamsize>(records[i].size()));
+        }
+        if (!output.flush())
+            throw std::runtime_error("Failed to write output file.");
+    }
+
+    // Оглавление записывается последним: его наличие означает, что контейнер полон.
+    std::vector<std::byte> index(count * INDEX_ENTRY_SIZE + TRAILER_SIZE);
+    for (uint64_t i = 0; i < count; ++i) {
+        std::byte* entry = &index[i * INDEX_ENTRY_SIZE];
+        store(entry, offsets[i], 8);
+        store(entry + 8, header.chunkLength(i), 4);
+        store(entry + 12, packed[i], 4);
+    }
+    std::byte* trailer = &index[count * INDEX_ENTRY_SIZE];
+    store(trailer, position, 8);
+    store(trailer + 8, count, 8);
+    std::memcpy(trailer + 16, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    if (!output.write(reinterpret_cast<const char*>(index.data()),
+                      static_cast<std::streamsize>(index.size()))
+        || !output.flush())
+        throw std::runtime_error("Failed to write output file.");
+}
+
+void GOST_28147_89_Common::decryptContainer(const std::string& input_filename,
+                                            const std::string& output_filename,
+                                            unsigned char param_set,
+                                            const ChunkCipher& cipher) const
+{
+    Container container;
+    openContainer(container, input_filename, param_set, cipher, m_container_mac);
+    const Header& header = container.header;
+    const uint64_t count = header.chunkCount();
+
+    // Открытый текст пишется во временный файл рядом с результатом и заменяет его
+    // только после проверки имитовставок всех участков: при ошибке на диске не
+    // остается непроверенного открытого текста, а прежний файл результата цел.
+    const std::string temporary = output_filename + ".partial";
+    try {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        if (!output)
+            throw std::runtime_error("Failed to open output file.");
+
+        const size_t group = m_pool ? m_pool->size() : 1;
+        std::vector<std::vector<std::byte>> records(group), plain(group);
+        for (uint64_t first = 0; first < count; first += group) {
+            const size_t n =
+                static_cast<size_t>(std::min<uint64_t>(group, count - first));
+            for (size_t i = 0; i < n; ++i)
+                readRecord(container, first + i, records[i]);
+
+            auto process = [&](size_t i)
+            {
+                const uint64_t chunk = first + i;
+                const block_t iv =
+                    advanceCounter(header.iv, chunk * (header.chunk_size / 8));
+                decryptRecord(header, chunk, iv, container.packed[chunk], records[i],
+                              plain[i], cipher);
+            };
+            if (m_pool)
+                m_pool->parallelFor(n, process);
+            else
+                process(0);
+
+            // Дополнение последнего участка отбрасывается.
+            for (size_t i = 0; i < n; ++i) {
+                const size_t length = header.chunkLength(first + i);
+                output.write(reinterpret_cast<const char*>(plain[i].data()),
+                             static_cast<std::streamsize>(length));
+            }
+            if (!output)
+                throw std::runtime_error("Failed to write output file.");
+        }
+        output.close();
+        if (!output)
+            throw std::runtime_error("Failed to write output file.");
+        std::filesystem::rename(temporary, output_filename);
+    } catch (...) {
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        throw;
+    }
+}
+
+size_t GOST_28147_89_Common::readContainerRange(const std::string& filename,
+                                                unsigned char param_set,
+                                                uint64_t offset,
+                                                std::span<std::byte> output,
+                                                const ChunkCipher& cipher) const
+{
+    Container container;
+    openContainer(container, filename, param_set, cipher, m_container_mac);
+    const Header& header = container.header;
+    if (offset >= header.length || output.empty())
+        return 0;
+
+    const uint64_t end = std::min<uint64_t>(header.length, offset + output.size());
+    std::vector<std::byte> record, plain;
+    for (uint64_t chunk = offset / header.chunk_size; chunk * header.chunk_size < end;
+         ++chunk) {
+        readRecord(container, chunk, record);
+        decryptRecord(header, chunk,
+                      advanceCounter(header.iv, chunk * (header.chunk_size / 8)),
+                      container.packed[chunk], record, plain, cipher);
+
+        // Пересечение участка с запрошенным диапазоном.
+        const uint64_t chunk_begin = chunk * header.chunk_size;
+        const uint64_t from        = std::max(offset, chunk_begin);
+        const uint64_t to = std::min(end, chunk_begin + header.chunkLength(chunk));
+        std::memcpy(output.data() + (from - offset), plain.data() + (from - chunk_begin),
+                    static_cast<size_t>(to - from));
+    }
+    return static_cast<size_t>(end - offset);
+}
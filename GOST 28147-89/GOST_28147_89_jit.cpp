@@ -0,0 +1,464 @@
+﻿#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "GOST_28147_89.h"
+
+// Код шифрования, сгенерированный для конкретного ключа (см. setJit).
+// Для каждого ключа создаются три функции: зашифрование и расшифрование ECB и
+// режим CTR (формирование значений счетчика, шифрование и наложение гаммы). Все 32
+// раунда развернуты, раундовые ключи записаны в команды непосредственными
+// операндами, а адрес таблиц замены загружается в регистр один раз. Как и
+// ядро interleaved, функции обрабатывают по четыре независимых блока, чередуя их
+// раунды; состояние блоков находится в регистрах r8 - r15.
+//
+// Код размещается в анонимном отображении памяти, которое после записи делается
+// исполняемым и недоступным для записи. Генератор поддерживает только x86-64 с
+// соглашением о вызовах System V (Linux, BSD); на других платформах, а также если
+// ОС запрещает исполняемую память, setJit возвращает false.
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Сгенерированный код для одного ключа. Код содержит раундовые ключи, поэтому при
+ * уничтожении стирается.
+ */
+class JitCipher
+{
+public:
+    using byte_t        = GOST_28147_89_Common::byte_t;
+    using round_keys_t  = GOST_28147_89_Common::round_keys_t;
+    using round_table_t = GOST_28147_89_Common::round_table_t;
+    using ecb_t         = void (*)(const byte_t* in, byte_t* out, size_t groups);
+    using ctr_t         = void (*)(uint64_t counter, const byte_t* in, byte_t* out,
+                           size_t groups);
+
+    // Количество блоков, обрабатываемых за один шаг.
+    static constexpr size_t WAYS = 4;
+
+    /**
+     * @return Код для раундовых ключей encrypt и decrypt или nullptr, если
+     * исполняемую память получить не удалось.
+     */
+    static std::shared_ptr<const JitCipher> compile(const round_table_t& tables,
+                                                    const round_keys_t& encrypt,
+                                                    const round_keys_t& decrypt)
+    {
+        Emitter emitter(tables);
+        const size_t encrypt_offset = emitter.ecb(encrypt);
+        const size_t decrypt_offset = emitter.ecb(decrypt);
+        const size_t counter_offset = emitter.ctr(encrypt);
+
+        std::vector<byte_t>& code = emitter.code;
+        const size_t page         = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t size         = (code.size() + page - 1) / page * page;
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            GOST_28147_89_Common::secureWipe(code.data(), code.size());
+            return nullptr;
+        }
+        std::memcpy(memory, code.data(), code.size());
+        GOST_28147_89_Common::secureWipe(code.data(), code.size());
+
+        // Память не бывает одновременно записываемой и исполняемой.
+        std::shared_ptr<JitCipher> jit(new JitCipher(memory, size));
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+            return nullptr;
+
+        byte_t* base = static_cast<byte_t*>(memory);
+        jit->encrypt = reinterpret_cast<ecb_t>(base + encrypt_offset);
+        jit->decrypt = reinterpret_cast<ecb_t>(base + decrypt_offset);
+        jit->counter = reinterpret_cast<ctr_t>(base + counter_offset);
+        return jit;
+    }
+
+    ~JitCipher()
+    {
+        if (mprotect(m_memory, m_size, PROT_READ | PROT_WRITE) == 0)
+            GOST_28147_89_Common::secureWipe(m_memory, m_size);
+        munmap(m_memory, m_size);
+    }
+
+    JitCipher(const JitCipher&)            = delete;
+    JitCipher& operator=(const JitCipher&) = delete;
+
+    ecb_t encrypt = nullptr;
+    ecb_t decrypt = nullptr;
+    ctr_t counter = nullptr;
+
+private:
+    JitCipher(void* memory, size_t size)
+        : m_memory(memory)
+        , m_size(size)
+    {
+    }
+
+    /**
+     * Генератор машинного кода. Регистры:
+     * eax - аргумент функции f, ecx - индекс в таблице, edx - результат f,
+     * rbx - адрес таблиц замены, rsi - входные данные, rdi - выходные данные,
+     * rbp - счетчик (CTR), r8 - r15 - половины четырех блоков, [rsp] - количество
+     * оставшихся шагов.
+     */
+    class Emitter
+    {
+    public:
+        enum Register : byte_t
+        {
+            RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+            R8, R9, R10, R11, R12, R13, R14, R15,
+        };
+
+        explicit Emitter(const round_table_t& tables)
+            : m_tables(&tables)
+        {
+        }
+
+        /**
+         * void ecb(const byte_t* in, byte_t* out, size_t groups)
+         * @return Смещение функции в коде.
+         */
+        size_t ecb(const round_keys_t& schedule)
+        {
+            const size_t start = code.size();
+            prologue();
+            // Аргументы: rdi - in, rsi - out, rdx - groups.
+            mov64(RAX, RDI);
+            mov64(RDI, RSI);
+            mov64(RSI, RAX);
+            push(RDX);
+
+            const size_t loop = code.size();
+            Register A[WAYS], B[WAYS];
+            for (size_t w = 0; w < WAYS; ++w) {
+                B[w] = static_cast<Register>(R8 + 2 * w);
+                A[w] = static_cast<Register>(R9 + 2 * w);
+                load32(B[w], RSI, 8 * w);
+                load32(A[w], RSI, 8 * w + 4);
+                bswap32(B[w]);
+                bswap32(A[w]);
+            }
+            rounds(schedule, A, B);
+            for (size_t w = 0; w < WAYS; ++w) {
+                bswap32(A[w]);
+                bswap32(B[w]);
+                store32(RDI, 8 * w, A[w]);
+                store32(RDI, 8 * w + 4, B[w]);
+            }
+            next(loop, false);
+            epilogue();
+            return start;
+        }
+
+        /**
+         * void ctr(uint64_t counter, const byte_t* in, byte_t* out, size_t groups)
+         * @return Смещение функции в коде.
+         */
+        size_t ctr(const round_keys_t& schedule)
+        {
+            const size_t start = code.size();
+            prologue();
+            // Аргументы: rdi - counter, rsi - in, rdx - out, rcx - groups.
+            mov64(RBP, RDI);
+            mov64(RDI, RDX);
+            push(RCX);
+
+            const size_t loop = code.size();
+            Register A[WAYS], B[WAYS];
+            for (size_t w = 0; w < WAYS; ++w) {
+                B[w] = static_cast<Register>(R8 + 2 * w);
+                A[w] = static_cast<Register>(R9 + 2 * w);
+                // Блок счетчика: старшая половина - B, младшая - A.
+                mov64(RAX, RBP);
+                emit({ 0x48, 0x83, 0xC0, static_cast<byte_t>(w) }); // add rax, w
+                mov32(A[w], RAX);
+                emit({ 0x48, 0xC1, 0xE8, 0x20 }); // shr rax, 32
+                mov32(B[w], RAX);
+            }
+            rounds(schedule, A, B);
+            for (size_t w = 0; w < WAYS; ++w) {
+                bswap32(A[w]);
+                bswap32(B[w]);
+                xorLoad32(A[w], RSI, 8 * w);
+                xorLoad32(B[w], RSI, 8 * w + 4);
+                store32(RDI, 8 * w, A[w]);
+                store32(RDI, 8 * w + 4, B[w]);
+            }
+            next(loop, true);
+            epilogue();
+            return start;
+        }
+
+        std::vector<byte_t> code;
+
+    private:
+        void emit(std::initializer_list<byte_t> bytes)
+        {
+            code.insert(code.end(), bytes);
+        }
+
+        void emit32(uint32_t value)
+        {
+            for (size_t i = 0; i < 4; ++i)
+                code.push_back(static_cast<byte_t>(value >> 8 * i));
+        }
+
+        /**
+         * Префикс REX для регистров r8 - r15 (reg - поле reg, rm - поле r/m).
+         */
+        void rex(bool wide, byte_t reg, byte_t rm)
+        {
+            const byte_t prefix = static_cast<byte_t>(0x40 | wide << 3 | (reg >> 3) << 2
+                                                      | (rm >> 3));
+            if (prefix != 0x40)
+                code.push_back(prefix);
+        }
+
+        static byte_t modrm(byte_t mod, byte_t reg, byte_t rm)
+        {
+            return static_cast<byte_t>(mod << 6 | (reg & 7) << 3 | (rm & 7));
+        }
+
+        void push(Register reg)
+        {
+            rex(false, 0, reg);
+            code.push_back(static_cast<byte_t>(0x50 + (reg & 7)));
+        }
+
+        void pop(Register reg)
+        {
+            rex(false, 0, reg);
+            code.push_back(static_cast<byte_t>(0x58 + (reg & 7)));
+        }
+
+        // mov dst, src (64 и 32 бита).
+        void mov64(Register dst, Register src)
+        {
+            rex(true, src, dst);
+            emit({ 0x89, modrm(3, src, dst) });
+        }
+
+        void mov32(Register dst, Register src)
+        {
+            rex(false, src, dst);
+            emit({ 0x89, modrm(3, src, dst) });
+        }
+
+        // mov reg, [base + disp]; mov [base + disp], reg; xor reg, [base + disp].
+        // base - rsi или rdi, поэтому байт SIB не нужен.
+        void load32(Register reg, Register base, size_t disp)
+        {
+            memory32(0x8B, reg, base, disp);
+        }
+
+        void store32(Register base, size_t disp, Register reg)
+        {
+            memory32(0x89, reg, base, disp);
+        }
+
+        void xorLoad32(Register reg, Register base, size_t disp)
+        {
+            memory32(0x33, reg, base, disp);
+        }
+
+        void memory32(byte_t opcode, Register reg, Register base, size_t disp)
+        {
+            rex(false, reg, base);
+            emit({ opcode, modrm(1, reg, base), static_cast<byte_t>(disp) });
+        }
+
+        void bswap32(Register reg)
+        {
+            rex(false, 0, reg);
+            emit({ 0x0F, static_cast<byte_t>(0xC8 + (reg & 7)) });
+        }
+
+        /**
+         * mov edx или xor edx, [rbx + rcx * 4 + 1024 * table].
+         */
+        void lookup(byte_t opcode, size_t table)
+        {
+            emit({ opcode, modrm(2, RDX, RSP), 0x8B });
+            emit32(static_cast<uint32_t>(table * sizeof((*m_tables)[0])));
+        }
+
+        /**
+         * Раунд одного блока: B ^= f(A + key).
+         */
+        void round(Register A, Register B, uint32_t key)
+        {
+            mov32(RAX, A);
+            code.push_back(0x05); // add eax, key
+            emit32(key);
+            emit({ 0x0F, 0xB6, 0xC8 }); // movzx ecx, al
+            lookup(0x8B, 0);
+            emit({ 0x0F, 0xB6, 0xCC }); // movzx ecx, ah
+            lookup(0x33, 1);
+            emit({ 0xC1, 0xE8, 0x10 }); // shr eax, 16
+            emit({ 0x0F, 0xB6, 0xC8 });
+            lookup(0x33, 2);
+            emit({ 0x0F, 0xB6, 0xCC });
+            lookup(0x33, 3);
+            rex(false, RDX, B); // xor B, edx
+            emit({ 0x31, modrm(3, RDX, B) });
+        }
+
+        /**
+         * 32 раунда четырех блоков. Половины не переставляются: после раунда
+         * регистры A и B просто меняются ролями.
+         */
+        void rounds(const round_keys_t& schedule, Register (&A)[WAYS],
+                    Register (&B)[WAYS])
+        {
+            for (size_t r = 0; r < 32; ++r) {
+                for (size_t w = 0; w < WAYS; ++w) {
+                    round(A[w], B[w], schedule[r]);
+                    std::swap(A[w], B[w]);
+                }
+            }
+        }
+
+        /**
+         * Переход к следующим четырем блокам и повтор цикла loop, пока не
+         * исчерпано количество шагов.
+         */
+        void next(size_t loop, bool counter)
+        {
+            emit({ 0x48, 0x83, 0xC6, 8 * WAYS }); // add rsi, 32
+            emit({ 0x48, 0x83, 0xC7, 8 * WAYS }); // add rdi, 32
+            if (counter)
+                emit({ 0x48, 0x83, 0xC5, WAYS }); // add rbp, 4
+            emit({ 0x48, 0xFF, 0x0C, 0x24 });     // dec qword [rsp]
+            emit({ 0x0F, 0x85 });                 // jnz loop
+            emit32(static_cast<uint32_t>(loop - (code.size() + 4)));
+            emit({ 0x48, 0x83, 0xC4, 0x08 }); // add rsp, 8
+        }
+
+        void prologue()
+        {
+            for (Register reg : { RBX, RBP, R12, R13, R14, R15 })
+                push(reg);
+            // mov rbx, tables
+            emit({ 0x48, 0xBB });
+            const uint64_t address = reinterpret_cast<uintptr_t>(m_tables);
+            emit32(static_cast<uint32_t>(address));
+            emit32(static_cast<uint32_t>(address >> 32));
+        }
+
+        void epilogue()
+        {
+            for (Register reg : { R15, R14, R13, R12, RBP, RBX })
+                pop(reg);
+            code.push_back(0xC3); // ret
+        }
+
+        const round_table_t* m_tables;
+    };
+
+    void* m_memory;
+    size_t m_size;
+};
+
+bool GOST_28147_89_Common::enableJit(const round_table_t* tables)
+{
+    m_jit_tables = tables;
+    m_jit.reset();
+    if (!tables)
+        return false;
+
+    auto jit = JitCipher::compile(*tables, m_encrypt_schedule, m_decrypt_schedule);
+    if (!jit)
+        return false;
+
+    // Сгенерированный код сверяется с общим ядром, как и ядра при выборе.
+    constexpr size_t COUNT = 3 * JitCipher::WAYS;
+    byte_t input[COUNT * 8], expected[COUNT * 8], output[COUNT * 8];
+    for (size_t i = 0; i < sizeof(input); ++i)
+        input[i] = static_cast<byte_t>(i * 37 + 11);
+
+    bool valid = true;
+    for (const auto& [schedule, code] :
+         { std::pair(&m_encrypt_schedule, jit->encrypt),
+           std::pair(&m_decrypt_schedule, jit->decrypt) }) {
+        runKernels(*tables, *schedule, input, expected, COUNT);
+        code(input, output, COUNT / JitCipher::WAYS);
+        valid = valid && std::memcmp(output, expected, sizeof(output)) == 0;
+    }
+
+    // Счетчик начинается с 2^32 - 2, чтобы проверить перенос в старшую половину.
+    const uint64_t counter = 0xFFFFFFFE;
+    for (size_t i = 0; i < COUNT; ++i)
+        for (size_t j = 0; j < 8; ++j)
+            expected[i * 8 + j] = static_cast<byte_t>((counter + i) >> (56 - 8 * j));
+    runKernels(*tables, m_encrypt_schedule, expected, expected, COUNT);
+    for (size_t i = 0; i < sizeof(input); ++i)
+        expected[i] ^= input[i];
+    jit->counter(counter, input, output, COUNT / JitCipher::WAYS);
+    valid = valid && std::memcmp(output, expected, sizeof(output)) == 0;
+
+    secureWipe(expected, sizeof(expected));
+    secureWipe(output, sizeof(output));
+    if (!valid)
+        return false;
+
+    m_jit = std::move(jit);
+    return true;
+}
+
+size_t GOST_28147_89_Common::runJit(const round_keys_t& schedule, const byte_t* in,
+                                    byte_t* out, size_t count) const
+{
+    if (!m_jit)
+        return 0;
+
+    JitCipher::ecb_t code = nullptr;
+    if (&schedule == &m_encrypt_schedule)
+        code = m_jit->encrypt;
+    else if (&schedule == &m_decrypt_schedule)
+        code = m_jit->decrypt;
+
+    const size_t groups = count / JitCipher::WAYS;
+    if (!code || groups == 0)
+        return 0;
+    code(in, out, groups);
+    return groups * JitCipher::WAYS;
+}
+
+size_t GOST_28147_89_Common::runJitCounter(uint64_t counter, const byte_t* in,
+                                           byte_t* out, size_t count) const
+{
+    // Переполнение счетчика обнаруживает общий путь.
+    const size_t groups = count / JitCipher::WAYS;
+    if (!m_jit || groups == 0 || count > UINT64_MAX - counter)
+        return 0;
+    m_jit->counter(counter, in, out, groups);
+    return groups * JitCipher::WAYS;
+}
+
+#else
+
+bool GOST_28147_89_Common::enableJit(const round_table_t* tables)
+{
+    m_jit_tables = tables;
+    return false;
+}
+
+size_t GOST_28147_89_Common::runJit(const round_keys_t&, const byte_t*, byte_t*,
+                                    size_t) const
+{
+    return 0;
+}
+
+size_t GOST_28147_89_Common::runJitCounter(uint64_t, const byte_t*, byte_t*,
+                                           size_t) const
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,240 @@
+﻿#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "GOST_28147_89.h"
+
+// Выбор ядра шифрования во время выполнения.
+// Одна сборка библиотеки содержит все ядра; при первом обращении каждое ядро,
+// поддерживаемое процессором, проверяется по эталонной скалярной реализации, и
+// выбирается самое быстрое из прошедших проверку. Ядро обрабатывает столько блоков,
+// сколько кратно его ширине; остаток передается следующему ядру списка, поэтому
+// последнее (скалярное) ядро обрабатывает любой остаток.
+
+namespace
+{
+    using byte_t        = GOST_28147_89_Common::byte_t;
+    using round_keys_t  = GOST_28147_89_Common::round_keys_t;
+    using round_table_t = GOST_28147_89_Common::round_table_t;
+    using kernel_t      = size_t (*)(const round_table_t& tables,
+                                const round_keys_t& schedule, const byte_t* in,
+                                byte_t* out, size_t count);
+
+    uint32_t load(const byte_t* data)
+    {
+        return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16
+               | static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[3]);
+    }
+
+    void store(byte_t* data, uint32_t value)
+    {
+        data[0] = static_cast<byte_t>(value >> 24);
+        data[1] = static_cast<byte_t>(value >> 16);
+        data[2] = static_cast<byte_t>(value >> 8);
+        data[3] = static_cast<byte_t>(value);
+    }
+
+    inline uint32_t f(const round_table_t& tables, uint32_t x)
+    {
+        return tables[0][x & 0xFF] ^ tables[1][(x >> 8) & 0xFF]
+               ^ tables[2][(x >> 16) & 0xFF] ^ tables[3][x >> 24];
+    }
+
+    /**
+     * Эталонное ядро: блоки по одному, как в block_cipher.
+     */
+    size_t blockCipherScalar(const round_table_t& tables, const round_keys_t& schedule,
+                             const byte_t* in, byte_t* out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i, in += 8, out += 8) {
+            uint32_t B = load(in);
+            uint32_t A = load(in + 4);
+            for (size_t r = 0; r < 32; ++r) {
+                const uint32_t B_bits = B ^ f(tables, A + schedule[r]);
+                B                     = A;
+                A                     = B_bits;
+            }
+            store(out, A);
+            store(out + 4, B);
+        }
+        return count;
+    }
+
+    /**
+     * Раунды нескольких независимых блоков чередуются, и процессор выполняет их
+     * цепочки зависимостей одновременно.
+     */
+    size_t blockCipherInterleaved(const round_table_t& tables,
+                                  const round_keys_t& schedule, const byte_t* in,
+                                  byte_t* out, size_t count)
+    {
+        constexpr size_t WAYS = 4;
+        const size_t done     = count - count % WAYS;
+        for (size_t i = 0; i < done; i += WAYS) {
+            uint32_t A[WAYS], B[WAYS];
+            for (size_t w = 0; w < WAYS; ++w) {
+                B[w] = load(in + (i + w) * 8);
+                A[w] = load(in + (i + w) * 8 + 4);
+            }
+            for (size_t r = 0; r < 32; ++r) {
+                for (size_t w = 0; w < WAYS; ++w) {
+                    const uint32_t B_bits = B[w] ^ f(tables, A[w] + schedule[r]);
+                    B[w]                  = A[w];
+                    A[w]                  = B_bits;
+                }
+            }
+            for (size_t w = 0; w < WAYS; ++w) {
+                store(out + (i + w) * 8, A[w]);
+                store(out + (i + w) * 8 + 4, B[w]);
+            }
+        }
+        return done;
+    }
+
+    bool alwaysSupported() { return true; }
+} // namespace
+
+/**
+ * Список ядер и выбранное ядро. Результаты проверки не меняются после создания.
+ */
+class KernelRegistry
+{
+public:
+    struct Kernel
+    {
+        const char* name;
+        size_t width;
+        kernel_t function;
+        bool (*supported)();
+    };
+
+    // От самого быстрого к самому медленному; скалярное ядро - последнее.
+    static constexpr Kernel KERNELS[] = {
+        { "avx512", 16, &GOST_28147_89_Common::block_cipher_avx512,
+          &GOST_28147_89_Common::hasAvx512 },
+        { "avx2", 8, &GOST_28147_89_Common::block_cipher_avx2,
+          &GOST_28147_89_Common::hasAvx2 },
+        { "interleaved", 4, &blockCipherInterleaved, &alwaysSupported },
+        { "scalar", 1, &blockCipherScalar, &alwaysSupported },
+    };
+    static constexpr size_t KERNEL_COUNT = std::size(KERNELS);
+
+    bool supported[KERNEL_COUNT] = {};
+    bool verified[KERNEL_COUNT]  = {};
+    std::atomic<size_t> active { KERNEL_COUNT - 1 };
+
+    static KernelRegistry& instance()
+    {
+        static KernelRegistry registry;
+        return registry;
+    }
+
+    bool enabled(size_t i) const { return verified[i]; }
+
+    size_t best() const
+    {
+        size_t i = 0;
+        while (!enabled(i))
+            ++i;
+        return i;
+    }
+
+private:
+    KernelRegistry()
+    {
+        for (size_t i = 0; i < KERNEL_COUNT; ++i) {
+            supported[i] = KERNELS[i].supported();
+            verified[i]  = supported[i]
+                          && selfTest(KERNELS[i].function, KERNELS[i].width);
+        }
+        // Без исправного эталонного ядра результат шифрования нельзя проверить.
+        if (!verified[KERNEL_COUNT - 1])
+            throw std::runtime_error("GOST 28147-89 self-test failed.");
+        active = best();
+    }
+
+    /**
+     * Самопроверка ядра на наборе TC26 Z с ключом из контрольного примера
+     * ГОСТ Р 34.13-2015. Первый блок - открытый текст примера, остальные -
+     * псевдослучайные. Эталонное ядро сначала проверяется по шифротексту примера.
+     * Количество блоков не кратно ширине ядер, чтобы проверить и количество
+     * обработанных блоков, которое возвращает ядро.
+     */
+    static bool selfTest(kernel_t kernel, size_t width)
+    {
+        static constexpr round_table_t tables =
+            GOST_28147_89_Common::buildRoundTables(TC26_Z_ParamSet::s_blocks);
+        const uint32_t key[8] = { 0xFFEEDDCC, 0xBBAA9988, 0x77665544, 0x33221100,
+                                  0xF0F1F2F3, 0xF4F5F6F7, 0xF8F9FAFB, 0xFCFDFEFF };
+        const byte_t plaintext[8]  = { 0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10 };
+        const byte_t ciphertext[8] = { 0x4E, 0xE9, 0x01, 0xE5, 0xC2, 0xD8, 0xCA, 0x3D };
+
+        round_keys_t schedule;
+        for (size_t i = 0; i < 32; ++i)
+            schedule[i] = key[i < 24 ? i % 8 : 31 - i];
+
+        constexpr size_t COUNT = 4 * 16 + 7;
+        byte_t input[COUNT * 8], expected[COUNT * 8], output[COUNT * 8];
+        std::memcpy(input, plaintext, sizeof(plaintext));
+        uint32_t seed = 12345;
+        for (size_t i = sizeof(plaintext); i < sizeof(input); ++i) {
+            seed     = seed * 1103515245 + 12345;
+            input[i] = static_cast<byte_t>(seed >> 16);
+        }
+
+        blockCipherScalar(tables, schedule, input, expected, COUNT);
+        if (std::memcmp(expected, ciphertext, sizeof(ciphertext)) != 0)
+            return false;
+
+        const size_t done = kernel(tables, schedule, input, output, COUNT);
+        return done == COUNT - COUNT % width
+               && std::memcmp(output, expected, done * 8) == 0;
+    }
+};
+
+void GOST_28147_89_Common::runKernels(const round_table_t& tables,
+                                      const round_keys_t& schedule, const byte_t* in,
+                                      byte_t* out, size_t count)
+{
+    const KernelRegistry& registry = KernelRegistry::instance();
+    size_t done                     = 0;
+    for (size_t i = registry.active.load(std::memory_order_relaxed); done < count; ++i)
+        if (registry.enabled(i))
+            done += KernelRegistry::KERNELS[i].function(tables, schedule, in + done * 8,
+                                                        out + done * 8, count - done);
+}
+
+std::vector<GOST_28147_89_Common::KernelInfo> GOST_28147_89_Common::kernels()
+{
+    const KernelRegistry& registry = KernelRegistry::instance();
+    std::vector<KernelInfo> result;
+    for (size_t i = 0; i < KernelRegistry::KERNEL_COUNT; ++i) {
+        const auto& kernel = KernelRegistry::KERNELS[i];
+        result.push_back({ kernel.name, kernel.width, registry.supported[i],
+                           registry.verified[i] });
+    }
+    return result;
+}
+
+std::string GOST_28147_89_Common::kernel()
+{
+    const KernelRegistry& registry = KernelRegistry::instance();
+    return KernelRegistry::KERNELS[registry.active.load(std::memory_order_relaxed)].name;
+}
+
+bool GOST_28147_89_Common::setKernel(const std::string& name)
+{
+    KernelRegistry& registry = KernelRegistry::instance();
+    if (name == "auto") {
+        registry.active.store(registry.best(), std::memory_order_relaxed);
+        return true;
+    }
+    for (size_t i = 0; i < KernelRegistry::KERNEL_COUNT; ++i) {
+        if (name == KernelRegistry::KERNELS[i].name && registry.enabled(i)) {
+            registry.active.store(i, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+﻿#include "GOST_28147_89.h"
+
+// Обработка файлов через отображение в память (mmap).
+// Входной файл отображается только для чтения, выходной создается сразу нужной длины и
+// отображается для записи, после чего блоки шифруются непосредственно между
+// отображениями без промежуточных буферов и копирования в потоки. Если файл нельзя
+// отобразить (канал, устройство, пустой файл, платформа без mmap), функция возвращает
+// false и вызывающий код обрабатывает файл конвейером (см. processPipelinedFile).
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    /**
+     * Закрывает файловый дескриптор при выходе из области видимости.
+     */
+    struct FileDescriptor
+    {
+        int fd = -1;
+        ~FileDescriptor()
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+    };
+
+    /**
+     * Снимает отображение файла при выходе из области видимости.
+     */
+    struct Mapping
+    {
+        void* data  = MAP_FAILED;
+        size_t size = 0;
+        ~Mapping()
+        {
+            if (data != MAP_FAILED)
+                munmap(data, size);
+        }
+    };
+} // namespace
+
+bool GOST_28147_89_Common::processMappedFile(
+    const std::string& input_filename, const std::string& output_filename,
+    const std::function<void(std::span<const std::byte>, std::span<std::byte>)>& process)
+    const
+{
+    FileDescriptor input;
+    struct stat input_stat;
+    input.fd = open(input_filename.c_str(), O_RDONLY);
+    if (input.fd < 0 || fstat(input.fd, &input_stat) != 0 || !S_ISREG(input_stat.st_mode)
+        || input_stat.st_size == 0)
+        return false;
+
+    const size_t size   = static_cast<size_t>(input_stat.st_size);
+    const size_t padded = outputSize(size);
+
+    // Если входной и выходной файлы совпадают, данные обрабатываются на месте в одном
+    // отображении. Проверка выполняется до открытия выходного файла, чтобы не обрезать
+    // входные данные.
+    struct stat output_stat;
+    const bool in_place = stat(output_filename.c_str(), &output_stat) == 0
+                          && output_stat.st_dev == input_stat.st_dev
+                          && output_stat.st_ino == input_stat.st_ino;
+
+    FileDescriptor output;
+    const int flags = in_place ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC;
+    output.fd       = open(output_filename.c_str(), flags, 0644);
+    if (output.fd < 0)
+        return false;
+
+    // Длина файла меняется только после успешного отображения: при отказе файл при
+    // обработке на месте остается нетронутым и его можно обработать потоками.
+    Mapping output_map;
+    output_map.size = padded;
+    output_map.data =
+        mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_SHARED, output.fd, 0);
+    if (output_map.data == MAP_FAILED
+        || ftruncate(output.fd, static_cast<off_t>(padded)) != 0)
+        return false;
+
+    Mapping input_map;
+    if (!in_place) {
+        input_map.size = size;
+        input_map.data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, input.fd, 0);
+        if (input_map.data == MAP_FAILED)
+            return false;
+        madvise(input_map.data, size, MADV_SEQUENTIAL);
+    }
+    madvise(output_map.data, padded, MADV_SEQUENTIAL);
+
+    // Блоки шифруются непосредственно между отображениями.
+    const std::byte* in =
+        static_cast<const std::byte*>(in_place ? output_map.data : input_map.data);
+    process({ in, size }, { static_cast<std::byte*>(output_map.data), padded });
+    return true;
+}
+
+#else
+
+bool GOST_28147_89_Common::processMappedFile(
+    const std::string&, const std::string&,
+    const std::function<void(std::span<const std::byte>, std::span<std::byte>)>&) const
+{
+    return false;
+}
+
+#endif
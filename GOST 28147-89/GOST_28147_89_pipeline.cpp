@@ -0,0 +1,402 @@
+﻿#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "GOST_28147_89.h"
+
+// Конвейерная обработка файлов.
+// Чтение, шифрование и запись выполняются тремя стадиями в разных потоках и
+// передают друг другу буферы из небольшого кольца: пока одна порция шифруется,
+// следующая уже читается с диска, а предыдущая записывается. Время обработки
+// большого файла приближается к max(время ввода-вывода, время шифрования), а не к их
+// сумме. Буферы выделяются один раз и выровнены по границе страницы, что позволяет
+// использовать прямой ввод-вывод (O_DIRECT) в Linux.
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Количество буферов в кольце: по одному на каждую стадию и один запасной, чтобы
+    // чтение не ждало записи.
+    constexpr size_t PIPELINE_DEPTH = 4;
+
+    // Выравнивание буферов и размера порции, требуемое для O_DIRECT.
+    constexpr size_t BUFFER_ALIGNMENT = 4096;
+
+    /**
+     * Буфер кольца: выровненная область памяти и количество прочитанных байт.
+     */
+    struct Buffer
+    {
+        std::byte* data = nullptr;
+        size_t size     = 0;
+    };
+
+    /**
+     * Очередь номеров буферов между стадиями конвейера. Закрытие очереди будит все
+     * ожидающие потоки; после этого pop возвращает false.
+     */
+    class Channel
+    {
+    public:
+        void push(size_t index)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_items.push_back(index);
+            }
+            m_condition.notify_one();
+        }
+
+        bool pop(size_t& index)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+                return false;
+            index = m_items.front();
+            m_items.pop_front();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_condition.notify_all();
+        }
+
+    private:
+        std::deque<size_t> m_items;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_closed = false;
+    };
+
+    /**
+     * Кольцо выровненных буферов, выделяемых один раз на весь файл.
+     */
+    class BufferPool
+    {
+    public:
+        BufferPool(size_t count, size_t capacity)
+            : m_buffers(count)
+            , m_capacity(capacity)
+        {
+            for (auto& buffer : m_buffers)
+                buffer.data = static_cast<std::byte*>(
+                    ::operator new(capacity, std::align_val_t(BUFFER_ALIGNMENT)));
+        }
+
+        ~BufferPool()
+        {
+            for (auto& buffer : m_buffers)
+                ::operator delete(buffer.data, std::align_val_t(BUFFER_ALIGNMENT));
+        }
+
+        BufferPool(const BufferPool&)            = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        Buffer& operator[](size_t index) { return m_buffers[index]; }
+        size_t size() const { return m_buffers.size(); }
+        size_t capacity() const { return m_capacity; }
+
+    private:
+        std::vector<Buffer> m_buffers;
+        size_t m_capacity;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * Файл, открытый системными вызовами POSIX (поддерживает O_DIRECT).
+     */
+    class File
+    {
+    public:
+        ~File()
+        {
+            if (m_fd >= 0)
+                close(m_fd);
+        }
+
+        /**
+         * Открывает входной файл.
+         * @return false, если файл нельзя открыть.
+         */
+        bool openInput(const std::string& filename, bool direct)
+        {
+            m_fd = openDirect(filename, O_RDONLY, direct);
+            return m_fd >= 0;
+        }
+
+        /**
+         * Открывает выходной файл. Файл, совпадающий с входным, не обрезается:
+         * каждая порция записывается только после того, как прочитана.
+         */
+        bool openOutput(const std::string& filename, bool in_place, bool direct)
+        {
+            const int flags = in_place ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC;
+            m_fd            = openDirect(filename, flags, direct);
+            return m_fd >= 0;
+        }
+
+        /**
+         * Читает до size байт; меньшее количество означает конец файла.
+         */
+        size_t read(std::byte* data, size_t size)
+        {
+            size_t done = 0;
+            while (done < size) {
+                const ssize_t n = ::read(m_fd, data + done, size - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw std::runtime_error("Failed to read input file.");
+                done += static_cast<size_t>(n);
+                // При O_DIRECT продолжать чтение с невыровненного смещения нельзя, а
+                // короткое чтение обычного файла означает его конец.
+                if (n == 0 || (m_direct && done % BUFFER_ALIGNMENT != 0))
+                    break;
+            }
+            return done;
+        }
+
+        void write(const std::byte* data, size_t size)
+        {
+            // O_DIRECT требует длины, кратной размеру блока устройства; последняя
+            // порция файла записывается обычным образом.
+#ifdef O_DIRECT
+            if (m_direct && size % BUFFER_ALIGNMENT != 0) {
+                fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+                m_direct = false;
+            }
+#endif
+            size_t done = 0;
+            while (done < size) {
+                const ssize_t n = ::write(m_fd, data + done, size - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw std::runtime_error("Failed to write output file.");
+                done += static_cast<size_t>(n);
+            }
+        }
+
+    private:
+        /**
+         * Открывает файл с O_DIRECT, если это запрошено и поддерживается файловой
+         * системой, иначе обычным образом.
+         */
+        int openDirect(const std::string& filename, int flags, bool direct)
+        {
+#ifdef O_DIRECT
+            if (direct) {
+                const int fd = open(filename.c_str(), flags | O_DIRECT, 0644);
+                if (fd >= 0) {
+                    m_direct = true;
+                    return fd;
+                }
+            }
+#else
+            (void)direct;
+#endif
+            return open(filename.c_str(), flags, 0644);
+        }
+
+        int m_fd      = -1;
+        bool m_direct = false;
+    };
+
+    bool isSameFile(const std::string& input_filename, const std::string& output_filename)
+    {
+        struct stat input_stat, output_stat;
+        return stat(input_filename.c_str(), &input_stat) == 0
+               && stat(output_filename.c_str(), &output_stat) == 0
+               && input_stat.st_dev == output_stat.st_dev
+               && input_stat.st_ino == output_stat.st_ino;
+    }
+#else
+    /**
+     * Файл, открытый стандартными потоками (прямой ввод-вывод не поддерживается).
+     */
+    class File
+    {
+    public:
+        bool openInput(const std::string& filename, bool)
+        {
+            m_stream.open(filename, std::ios::in | std::ios::binary);
+            return m_stream.is_open();
+        }
+
+        bool openOutput(const std::string& filename, bool in_place, bool)
+        {
+            const auto mode = in_place ? std::ios::in | std::ios::out | std::ios::binary
+                                       : std::ios::out | std::ios::binary;
+            m_stream.open(filename, mode);
+            return m_stream.is_open();
+        }
+
+        size_t read(std::byte* data, size_t size)
+        {
+            m_stream.read(reinterpret_cast<char*>(data),
+                          static_cast<std::streamsize>(size));
+            if (m_stream.bad())
+                throw std::runtime_error("Failed to read input file.");
+            return static_cast<size_t>(m_stream.gcount());
+        }
+
+        void write(const std::byte* data, size_t size)
+        {
+            if (!m_stream.write(reinterpret_cast<const char*>(data),
+                                static_cast<std::streamsize>(size)))
+                throw std::runtime_error("Failed to write output file.");
+        }
+
+    private:
+        std::fstream m_stream;
+    };
+
+    bool isSameFile(const std::string& input_filename, const std::string& output_filename)
+    {
+        std::error_code error;
+        return std::filesystem::equivalent(input_filename, output_filename, error);
+    }
+#endif
+
+    /**
+     * Выполняет стадию конвейера в отдельном потоке. Исключение стадии сохраняется
+     * и закрывает все очереди, чтобы остальные стадии завершились.
+     */
+    class Stage
+    {
+    public:
+        template <typename Function>
+        Stage(Function function, std::vector<Channel*> channels)
+            : m_thread(
+                [this, function, channels]
+                {
+                    try {
+                        function();
+                    } catch (...) {
+                        m_error = std::current_exception();
+                        for (Channel* channel : channels)
+                            channel->close();
+                    }
+                })
+        {
+        }
+
+        /**
+         * Дожидается завершения стадии.
+         * @return Исключение, выброшенное стадией, или nullptr.
+         */
+        std::exception_ptr join()
+        {
+            m_thread.join();
+            return m_error;
+        }
+
+    private:
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
+} // namespace
+
+bool GOST_28147_89_Common::processPipelinedFile(
+    const std::string& input_filename, const std::string& output_filename, bool direct,
+    const std::function<void(std::span<std::byte>)>& process) const
+{
+    const bool in_place = isSameFile(input_filename, output_filename);
+    File input, output;
+    if (!input.openInput(input_filename, direct)
+        || !output.openOutput(output_filename, in_place, direct))
+        return false;
+
+    // Для O_DIRECT размер порции должен быть кратен размеру блока устройства.
+    const size_t alignment = direct ? BUFFER_ALIGNMENT : 1;
+    const size_t capacity  = (processingChunkSize() + alignment - 1) / alignment
+                            * alignment;
+    BufferPool pool(PIPELINE_DEPTH, capacity);
+
+    // Буфер проходит по кругу: empty -> (чтение) -> filled -> (шифрование) -> ready ->
+    // (запись) -> empty. Порция, прочитанная не полностью, - последняя; пустая порция
+    // в конце файла не записывается.
+    Channel empty, filled, ready;
+    for (size_t i = 0; i < pool.size(); ++i)
+        empty.push(i);
+    const std::vector<Channel*> channels = { &empty, &filled, &ready };
+
+    Stage reader(
+        [&]
+        {
+            size_t index;
+            while (empty.pop(index)) {
+                Buffer& buffer = pool[index];
+                buffer.size    = input.read(buffer.data, pool.capacity());
+                filled.push(index);
+                if (buffer.size < pool.capacity())
+                    break;
+            }
+            filled.close();
+        },
+        channels);
+
+    Stage writer(
+        [&]
+        {
+            size_t index;
+            while (ready.pop(index)) {
+                output.write(pool[index].data, pool[index].size);
+                empty.push(index);
+            }
+        },
+        channels);
+
+    // Шифрование выполняется в вызывающем потоке (и в пуле потоков шифра).
+    std::exception_ptr error;
+    try {
+        size_t index;
+        bool processed = false;
+        while (filled.pop(index)) {
+            Buffer& buffer = pool[index];
+            if (buffer.size == 0 && processed)
+                break;
+
+            // Последний неполный блок дополняется нулями, как при потоковой обработке.
+            const size_t padded = outputSize(buffer.size);
+            std::memset(buffer.data + buffer.size, 0, padded - buffer.size);
+            buffer.size = padded;
+            process({ buffer.data, padded });
+            ready.push(index);
+            processed = true;
+        }
+    } catch (...) {
+        error = std::current_exception();
+        empty.close();
+        filled.close();
+    }
+    ready.close();
+
+    const std::exception_ptr reader_error = reader.join();
+    const std::exception_ptr writer_error = writer.join();
+    for (const auto& stage_error : { error, reader_error, writer_error })
+        if (stage_error)
+            std::rethrow_exception(stage_error);
+    return true;
+}
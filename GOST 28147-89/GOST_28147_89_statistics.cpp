@@ -0,0 +1,167 @@
+﻿#include "GOST_28147_89.h"
+
+// Статистика шифрования.
+// Каждый вызов открытой функции шифрования добавляет к счетчикам своего режима
+// количество байт, блоков, время и (при включенном подсчете) такты процессора.
+// Счетчики - атомарные переменные с упорядочиванием relaxed: они только
+// накапливаются и не синхронизируют другие данные. Без GOST_STATISTICS учет вызовов
+// отсутствует, а функции запроса возвращают нули.
+
+#ifdef GOST_STATISTICS
+
+#include <atomic>
+#include <chrono>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    /**
+     * Счетчики одного режима. Режимы разнесены по разным строкам кэша, чтобы потоки,
+     * шифрующие в разных режимах, не мешали друг другу.
+     */
+    struct alignas(64) Counters
+    {
+        std::atomic<uint64_t> calls { 0 };
+        std::atomic<uint64_t> bytes { 0 };
+        std::atomic<uint64_t> blocks { 0 };
+        std::atomic<uint64_t> nanoseconds { 0 };
+        std::atomic<uint64_t> cycles { 0 };
+    };
+
+    std::array<Counters, GOST_28147_89_Common::METHOD_COUNT> counters;
+    std::atomic<bool> count_cycles { false };
+
+    int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+#if defined(__linux__)
+    /**
+     * Счетчик тактов текущего потока (perf_event_open), открывается при первом
+     * обращении из потока.
+     */
+    class CycleCounter
+    {
+    public:
+        CycleCounter()
+        {
+            perf_event_attr attr {};
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof(attr);
+            attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        ~CycleCounter()
+        {
+            if (m_fd >= 0)
+                close(m_fd);
+        }
+
+        bool available() const { return m_fd >= 0; }
+
+        uint64_t read() const
+        {
+            uint64_t value = 0;
+            if (m_fd < 0 || ::read(m_fd, &value, sizeof(value)) != sizeof(value))
+                return 0;
+            return value;
+        }
+
+    private:
+        int m_fd = -1;
+    };
+
+    const CycleCounter& cycleCounter()
+    {
+        thread_local const CycleCounter counter;
+        return counter;
+    }
+
+    bool cyclesAvailable() { return cycleCounter().available(); }
+    uint64_t readCycles() { return cycleCounter().read(); }
+#else
+    bool cyclesAvailable() { return false; }
+    uint64_t readCycles() { return 0; }
+#endif
+} // namespace
+
+GOST_28147_89_Common::CallStatistics::CallStatistics(Method method)
+    : m_method(method)
+    , m_start(now())
+    , m_count_cycles(count_cycles.load(std::memory_order_relaxed))
+    , m_start_cycles(m_count_cycles ? readCycles() : 0)
+{
+}
+
+GOST_28147_89_Common::CallStatistics::~CallStatistics()
+{
+    Counters& c = counters[static_cast<size_t>(m_method)];
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(m_bytes, std::memory_order_relaxed);
+    c.blocks.fetch_add(m_blocks, std::memory_order_relaxed);
+    c.nanoseconds.fetch_add(static_cast<uint64_t>(now() - m_start),
+                            std::memory_order_relaxed);
+    // Такты учитываются, только если подсчет был включен к началу вызова.
+    if (m_count_cycles)
+        c.cycles.fetch_add(readCycles() - m_start_cycles, std::memory_order_relaxed);
+}
+
+std::array<GOST_28147_89_Common::MethodStatistics, GOST_28147_89_Common::METHOD_COUNT>
+GOST_28147_89_Common::statistics()
+{
+    std::array<MethodStatistics, METHOD_COUNT> result;
+    for (size_t i = 0; i < METHOD_COUNT; ++i) {
+        result[i].calls       = counters[i].calls.load(std::memory_order_relaxed);
+        result[i].bytes       = counters[i].bytes.load(std::memory_order_relaxed);
+        result[i].blocks      = counters[i].blocks.load(std::memory_order_relaxed);
+        result[i].nanoseconds = counters[i].nanoseconds.load(std::memory_order_relaxed);
+        result[i].cycles      = counters[i].cycles.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void GOST_28147_89_Common::resetStatistics()
+{
+    for (auto& c : counters) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.bytes.store(0, std::memory_order_relaxed);
+        c.blocks.store(0, std::memory_order_relaxed);
+        c.nanoseconds.store(0, std::memory_order_relaxed);
+        c.cycles.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool GOST_28147_89_Common::enableCycleCounting(bool enable)
+{
+    enable = enable && cyclesAvailable();
+    count_cycles.store(enable, std::memory_order_relaxed);
+    return enable;
+}
+
+#else
+
+std::array<GOST_28147_89_Common::MethodStatistics, GOST_28147_89_Common::METHOD_COUNT>
+GOST_28147_89_Common::statistics()
+{
+    return {};
+}
+
+void GOST_28147_89_Common::resetStatistics() {}
+
+bool GOST_28147_89_Common::enableCycleCounting(bool)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,178 @@
+﻿#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "GOST_28147_89.h"
+
+/**
+ * Кэш объектов шифра с развернутыми ключами, индексируемый идентификатором ключа
+ * (например, идентификатором клиента на шлюзе, обслуживающем тысячи ключей).
+ *
+ * Для часто используемых ключей разбор ключа и построение раундовых ключей
+ * выполняются один раз, а не при каждом запросе. Размер кэша ограничен; при
+ * переполнении вытесняется ключ, который дольше всех не использовался (LRU).
+ * Объекты шифра выдаются как std::shared_ptr<const Cipher> и могут использоваться
+ * из многих потоков одновременно (вектор инициализации передается каждой операции
+ * явно). Вытесненный объект уничтожается, а его ключевой материал стирается, когда
+ * завершится последняя использующая его операция.
+ *
+ * Все функции кэша потокобезопасны.
+ */
+template <typename Cipher = GOST_28147_89>
+class KeyCache
+{
+public:
+    using key_t    = std::array<std::byte, 32>;
+    using loader_t = std::function<key_t(const std::string& key_id)>;
+
+    /**
+     * @param capacity - наибольшее количество ключей в кэше (не менее 1).
+     */
+    explicit KeyCache(size_t capacity)
+        : m_capacity(capacity == 0 ? 1 : capacity)
+    {
+    }
+
+    KeyCache(const KeyCache&)            = delete;
+    KeyCache& operator=(const KeyCache&) = delete;
+
+    /**
+     * Возвращает шифр для ключа key_id. Если ключа нет в кэше, он запрашивается
+     * функцией load (вне блокировки кэша, чтобы медленное хранилище ключей не
+     * задерживало другие потоки), разворачивается и помещается в кэш. Копия ключа,
+     * полученная от load, стирается.
+     * @param key_id - идентификатор ключа.
+     * @param load - функция, возвращающая ключ по идентификатору.
+     */
+    std::shared_ptr<const Cipher> get(const std::string& key_id, const loader_t& load)
+    {
+        if (auto cipher = find(key_id))
+            return cipher;
+
+        key_t key = load(key_id);
+        std::shared_ptr<const Cipher> cipher;
+        try {
+            cipher = std::make_shared<const Cipher>(std::span<const std::byte, 32>(key));
+        } catch (...) {
+            GOST_28147_89_Common::secureWipe(key.data(), key.size());
+            throw;
+        }
+        GOST_28147_89_Common::secureWipe(key.data(), key.size());
+        return insert(key_id, std::move(cipher));
+    }
+
+    /**
+     * @return Шифр для ключа key_id или nullptr, если ключа нет в кэше.
+     */
+    std::shared_ptr<const Cipher> find(const std::string& key_id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_index.find(key_id);
+        if (it == m_index.end())
+            return nullptr;
+
+        // Использованный ключ становится самым свежим.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->second;
+    }
+
+    /**
+     * Помещает в кэш ключ, заданный явно, и возвращает шифр для него.
+     */
+    std::shared_ptr<const Cipher> insert(const std::string& key_id,
+                                         std::span<const std::byte, 32> key)
+    {
+        return insert(key_id, std::make_shared<const Cipher>(key));
+    }
+
+    /**
+     * Удаляет ключ из кэша (например, при отзыве ключа клиента).
+     */
+    void erase(const std::string& key_id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_index.find(key_id);
+        if (it == m_index.end())
+            return;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    /**
+     * Изменяет наибольшее количество ключей, вытесняя лишние.
+     */
+    void setCapacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = capacity == 0 ? 1 : capacity;
+        evict();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    size_t capacity() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_capacity;
+    }
+
+private:
+    using entry_t = std::pair<std::string, std::shared_ptr<const Cipher>>;
+
+    std::shared_ptr<const Cipher> insert(const std::string& key_id,
+                                         std::shared_ptr<const Cipher> cipher)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_index.find(key_id);
+        if (it != m_index.end()) {
+            // Ключ заменяется; прежний шифр остается у тех, кто его уже получил.
+            it->second->second = std::move(cipher);
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->second;
+        }
+
+        m_entries.emplace_front(key_id, std::move(cipher));
+        m_index.emplace(key_id, m_entries.begin());
+        evict();
+        return m_entries.front().second;
+    }
+
+    /**
+     * Вытесняет давно не использовавшиеся ключи сверх m_capacity.
+     */
+    void evict()
+    {
+        while (m_entries.size() > m_capacity) {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    // Ключи в порядке использования: в начале - самый свежий.
+    std::list<entry_t> m_entries;
+    std::unordered_map<std::string, typename std::list<entry_t>::iterator> m_index;
+};
+
+#endif // !KEY_CACHE_H
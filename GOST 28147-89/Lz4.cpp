@@ -0,0 +1,200 @@
+﻿#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "Lz4.h"
+
+// Блок LZ4 - последовательность записей:
+//     токен: старшие 4 бита - длина литералов, младшие - длина совпадения минус 4
+//            (значение 15 означает, что длина продолжается байтами 255, ..., < 255)
+//     литералы
+//     смещение совпадения назад (2 байта, младший первым, 1 - 65535)
+//     продолжение длины совпадения
+// Последняя запись содержит только литералы. Последние 5 байт блока всегда
+// литералы, а последнее совпадение начинается не позже чем за 12 байт до конца.
+
+namespace
+{
+    constexpr size_t MIN_MATCH     = 4;
+    constexpr size_t LAST_LITERALS = 5;
+    constexpr size_t MATCH_LIMIT   = 12;
+    constexpr size_t MAX_OFFSET    = 65535;
+    constexpr size_t HASH_BITS     = 12;
+
+    uint32_t read32(const std::byte* data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    /**
+     * Запись в буфер с проверкой его границы.
+     */
+    class Writer
+    {
+    public:
+        explicit Writer(std::span<std::byte> output)
+            : m_output(output)
+        {
+        }
+
+        bool put(size_t value)
+        {
+            if (m_size == m_output.size())
+                return false;
+            m_output[m_size++] = static_cast<std::byte>(value);
+            return true;
+        }
+
+        /**
+         * Продолжение длины: байты 255 и последний байт меньше 255.
+         */
+        bool putLength(size_t length)
+        {
+            for (; length >= 255; length -= 255)
+                if (!put(255))
+                    return false;
+            return put(length);
+        }
+
+        bool putBytes(const std::byte* data, size_t size)
+        {
+            if (size > m_output.size() - m_size)
+                return false;
+            if (size == 0)
+                return true;
+            std::memcpy(m_output.data() + m_size, data, size);
+            m_size += size;
+            return true;
+        }
+
+        /**
+         * Записывает литералы и, если match_length != 0, совпадение.
+         */
+        bool sequence(const std::byte* literals, size_t literal_length, size_t offset,
+                      size_t match_length)
+        {
+            const size_t match_code = match_length == 0 ? 0 : match_length - MIN_MATCH;
+            return put(std::min<size_t>(literal_length, 15) << 4
+                       | std::min<size_t>(match_code, 15))
+                   && (literal_length < 15 || putLength(literal_length - 15))
+                   && putBytes(literals, literal_length)
+                   && (match_length == 0
+                       || (put(offset & 0xFF) && put(offset >> 8)
+                           && (match_code < 15 || putLength(match_code - 15))));
+        }
+
+        size_t size() const { return m_size; }
+
+    private:
+        std::span<std::byte> m_output;
+        size_t m_size = 0;
+    };
+} // namespace
+
+size_t Lz4::compress(std::span<const std::byte> input, std::span<std::byte> output)
+{
+    const std::byte* data = input.data();
+    const size_t size     = input.size();
+    Writer writer(output);
+    size_t anchor = 0;
+
+    if (size > MATCH_LIMIT) {
+        // Последняя позиция каждой четверки байт (по хешу).
+        std::array<uint32_t, size_t(1) << HASH_BITS> table {};
+        const size_t match_end = size - LAST_LITERALS;
+        size_t misses          = 0;
+        for (size_t i = 0; i + MATCH_LIMIT <= size;) {
+            const uint32_t sequence = read32(data + i);
+            uint32_t& slot          = table[hash(sequence)];
+            const size_t candidate  = slot;
+            slot                    = static_cast<uint32_t>(i);
+            if (candidate >= i || i - candidate > MAX_OFFSET
+                || read32(data + candidate) != sequence) {
+                // В несжимаемых данных шаг поиска постепенно растет.
+                i += 1 + (misses++ >> 6);
+                continue;
+            }
+
+            size_t length = MIN_MATCH;
+            while (i + length < match_end && data[candidate + length] == data[i + length])
+                ++length;
+            if (!writer.sequence(data + anchor, i - anchor, i - candidate, length))
+                return 0;
+            i += length;
+            anchor = i;
+            misses = 0;
+        }
+    }
+
+    if (!writer.sequence(data + anchor, size - anchor, 0, 0))
+        return 0;
+    return writer.size();
+}
+
+bool Lz4::decompress(std::span<const std::byte> input, std::span<std::byte> output)
+{
+    const std::byte* in = input.data();
+    std::byte* out      = output.data();
+    size_t ip = 0, op = 0;
+
+    auto readLength = [&](size_t& length)
+    {
+        uint8_t byte;
+        do {
+            if (ip == input.size())
+                return false;
+            byte = static_cast<uint8_t>(in[ip++]);
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    for (;;) {
+        if (ip == input.size())
+            return false;
+        const uint8_t token = static_cast<uint8_t>(in[ip++]);
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > input.size() - ip || literals > output.size() - op)
+            return false;
+        if (literals > 0)
+            std::memcpy(out + op, in + ip, literals);
+        ip += literals;
+        op += literals;
+
+        // Последняя запись содержит только литералы.
+        if (ip == input.size())
+            return op == output.size();
+
+        if (input.size() - ip < 2)
+            return false;
+        const size_t offset =
+            static_cast<size_t>(in[ip]) | static_cast<size_t>(in[ip + 1]) << 8;
+        ip += 2;
+        size_t length = token & 0xF;
+        if (length == 15 && !readLength(length))
+            return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > op || length > output.size() - op)
+            return false;
+
+        // Совпадение может перекрываться с копией (повторение коротких строк).
+        const std::byte* match = out + op - offset;
+        if (offset >= length)
+            std::memcpy(out + op, match, length);
+        else
+            for (size_t i = 0; i < length; ++i)
+                out[op + i] = match[i];
+        op += length;
+    }
+}
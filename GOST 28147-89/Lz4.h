@@ -0,0 +1,39 @@
+﻿#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <span>
+
+/**
+ * Сжатие блоков данных в формате LZ4 (LZ4 Block Format).
+ * Реализация без внешних зависимостей, совместимая с эталонной библиотекой lz4:
+ * поиск совпадений по хеш-таблице последних позиций (жадный разбор), поэтому
+ * сжатие и распаковка выполняются со скоростью порядка гигабайта в секунду,
+ * заметно превышающей скорость шифра. Используется контейнером (см.
+ * FileFormat::Container), чтобы хорошо сжимаемые данные (журналы, CSV) проходили
+ * через шифр и накопитель в сжатом виде.
+ */
+class Lz4
+{
+public:
+    /**
+     * Сжимает блок данных.
+     * @param input - исходные данные.
+     * @param output - буфер для сжатых данных.
+     * @return Размер сжатых данных или 0, если они не помещаются в output (в том
+     * числе если данные не сжимаются).
+     */
+    static size_t compress(std::span<const std::byte> input, std::span<std::byte> output);
+
+    /**
+     * Распаковывает блок данных. Все обращения к памяти проверяются, поэтому
+     * поврежденные данные не приводят к выходу за границы буферов.
+     * @param input - сжатые данные.
+     * @param output - буфер размером, в точности равным размеру исходных данных.
+     * @return false, если данные повреждены или их размер не совпадает с
+     * output.size().
+     */
+    static bool decompress(std::span<const std::byte> input, std::span<std::byte> output);
+};
+
+#endif // !LZ4_H
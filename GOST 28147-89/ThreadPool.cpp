@@ -0,0 +1,95 @@
+﻿#include <algorithm>
+#include <exception>
+
+#include "ThreadPool.h"
+
+namespace
+{
+    // Пул, рабочим потоком которого является текущий поток.
+    thread_local const ThreadPool* current_pool = nullptr;
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    m_workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop()
+{
+    current_pool = this;
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0)
+        return;
+    if (current_pool == this) {
+        for (size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    // Состояние группы задач: счетчик незавершенных задач и первое исключение.
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+    size_t remaining = count - 1;
+    std::exception_ptr error;
+
+    auto run = [&](size_t i)
+    {
+        std::exception_ptr local_error;
+        try {
+            task(i);
+        } catch (...) {
+            local_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (local_error && !error)
+            error = local_error;
+        if (i != 0 && --remaining == 0)
+            done_condition.notify_one();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 1; i < count; ++i)
+            m_tasks.emplace_back([&run, i] { run(i); });
+    }
+    m_condition.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_condition.wait(lock, [&] { return remaining == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
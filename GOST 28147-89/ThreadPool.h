@@ -0,0 +1,56 @@
+﻿#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Простой пул потоков фиксированного размера.
+ * Используется для параллельной обработки независимых участков данных.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Создает пул с заданным количеством рабочих потоков.
+     * @param thread_count - количество потоков (0 - по числу ядер процессора).
+     */
+    explicit ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @return Количество рабочих потоков.
+     */
+    size_t size() const { return m_workers.size(); }
+
+    /**
+     * Выполняет task(i) для каждого i из [0, count) и дожидается завершения всех
+     * вызовов. Первая задача выполняется в вызывающем потоке. Если какая-либо из задач
+     * выбросила исключение, оно повторно выбрасывается в вызывающем потоке.
+     * Вложенный вызов из задачи этого же пула выполняет задачи последовательно в
+     * своем потоке: ожидание в рабочем потоке могло бы занять все потоки пула
+     * ожидающими задачами (взаимная блокировка).
+     * @param count - количество задач.
+     * @param task - функция, принимающая номер задачи.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+#endif // !THREAD_POOL_H
@@ -1,12 +1,40 @@
-﻿#include <cassert>
+﻿#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "GOST_28147_89.h"
+#include "KeyCache.h"
+#include "Lz4.h"
 
 void printBytes(const std::string& str);
+void printStatistics();
 void testEncryptDecrypt(const std::string& plaintext, GOST_28147_89::Method method,
                         GOST_28147_89& gost);
+void testEncryptDecryptBuffer(const std::string& plaintext, GOST_28147_89::Method method,
+                              const GOST_28147_89& gost);
+void testKnownAnswer();
+void testIncremental(const std::string& plaintext, GOST_28147_89::Method method,
+                     const GOST_28147_89& gost);
+void testCounterRange(const std::string& plaintext, const GOST_28147_89& gost);
+void testMac(const std::string& plaintext, GOST_28147_89::Method method,
+             GOST_28147_89& gost);
+void testBatch(GOST_28147_89::Method method, GOST_28147_89& gost);
+void testKeystream(const std::string& plaintext, GOST_28147_89::Method method,
+                   const GOST_28147_89& gost);
+void testSharedCipher(GOST_28147_89::Method method, const GOST_28147_89& gost);
+void testKeyCache(GOST_28147_89::Method method, const GOST_28147_89& gost);
+void testMissingFile(GOST_28147_89& gost);
+void testContainer(GOST_28147_89::Method method, GOST_28147_89& gost);
+void testLz4();
+void testCompressedContainer(GOST_28147_89& gost);
+void testKernels(const GOST_28147_89& gost);
+void testJit(const GOST_28147_89& gost);
 
 int main()
 {
@@ -19,12 +47,33 @@ int main()
     testEncryptDecrypt("GOST 28147-89", GOST_28147_89::Method::CBC, gost);
     testEncryptDecrypt("OpenAI rocks!", GOST_28147_89::Method::CFB, gost);
     testEncryptDecrypt("Simple Text!", GOST_28147_89::Method::OFB, gost);
+    testEncryptDecryptBuffer("Record #42: 40 bytes of in-memory data.",
+                             GOST_28147_89::Method::CTR, gost);
+    testKnownAnswer();
+    testIncremental("Packets of arbitrary length", GOST_28147_89::Method::CFB, gost);
+    testCounterRange("Any byte range can be decrypted directly.", gost);
+    testMac("Integrity is checked in the same pass.", GOST_28147_89::Method::CBC, gost);
+    testBatch(GOST_28147_89::Method::OFB, gost);
+    gost.setInitializationVector(iv);
+    testKeystream("Keystream is ready before data arrives.", GOST_28147_89::Method::OFB,
+                  gost);
+    testSharedCipher(GOST_28147_89::Method::CBC, gost);
+    testKeyCache(GOST_28147_89::Method::CTR, gost);
+    testMissingFile(gost);
+    testContainer(GOST_28147_89::Method::CBC, gost);
+    testLz4();
+    testCompressedContainer(gost);
+    testKernels(gost);
+    testJit(gost);
 
     std::cout << "All tests passed!" << std::endl;
 
     gost.encryptFile("test.txt");
     gost.decryptFile("test_encrypted.txt");
 
+    if (GOST_28147_89::statisticsEnabled)
+        printStatistics();
+
     return 0;
 }
 
@@ -37,6 +86,20 @@ void printBytes(const std::string& str)
     std::cout << std::endl;
 }
 
+void printStatistics()
+{
+    const char* names[] = { "ECB", "CBC", "CFB", "OFB", "CTR" };
+    const auto statistics = GOST_28147_89::statistics();
+    std::cout << std::dec << std::setfill(' ') << "\n[ STATISTICS ]" << std::endl;
+    for (size_t i = 0; i < statistics.size(); ++i) {
+        const auto& s = statistics[i];
+        std::cout << names[i] << ": " << s.calls << " calls, " << s.bytes << " bytes, "
+                  << s.blocks << " blocks, " << std::fixed << std::setprecision(0)
+                  << s.nanosecondsPerCall() << " ns/call, " << std::setprecision(2)
+                  << s.megabytesPerSecond() << " MB/s" << std::endl;
+    }
+}
+
 void testEncryptDecrypt(const std::string& plaintext, GOST_28147_89::Method method,
                         GOST_28147_89& gost)
 {
@@ -60,4 +123,567 @@ void testEncryptDecrypt(const std::string& plaintext, GOST_28147_89::Method meth
     std::cout << "[ SUCCESS ] Test passed for method " << static_cast<int>(method)
               << std::endl
               << std::endl;
-}
\ No newline at end of file
+}
+
+void testEncryptDecryptBuffer(const std::string& plaintext, GOST_28147_89::Method method,
+                              const GOST_28147_89& gost)
+{
+    std::array<std::byte, 64> encrypted;
+    std::array<std::byte, 64> decrypted;
+    assert(GOST_28147_89::outputSize(plaintext.size()) <= encrypted.size());
+
+    const size_t size =
+        gost.encrypt(method, std::as_bytes(std::span(plaintext)), encrypted);
+    gost.decrypt(method, std::span(encrypted).first(size), decrypted);
+
+    assert(std::memcmp(decrypted.data(), plaintext.data(), plaintext.size()) == 0);
+    std::cout << "[ SUCCESS ] Buffer test passed for method " << static_cast<int>(method)
+              << std::endl
+              << std::endl;
+}
+
+// Контрольный пример из ГОСТ Р 34.12-2015 (шифр «Магма», набор параметров TC26 Z).
+void testKnownAnswer()
+{
+    const std::array<unsigned char, 32> key = {
+        0xFF, 0xEE, 0xDD, 0xCC, 0xBB, 0xAA, 0x99, 0x88, 0x77, 0x66, 0x55,
+        0x44, 0x33, 0x22, 0x11, 0x00, 0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5,
+        0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+    };
+    const std::array<unsigned char, 8> plaintext  = { 0xFE, 0xDC, 0xBA, 0x98,
+                                                      0x76, 0x54, 0x32, 0x10 };
+    const std::array<unsigned char, 8> ciphertext = { 0x4E, 0xE9, 0x01, 0xE5,
+                                                      0xC2, 0xD8, 0xCA, 0x3D };
+
+    GOST_28147_89_Basic<TC26_Z_ParamSet> magma(std::as_bytes(std::span(key)));
+    std::array<unsigned char, 8> encrypted;
+    magma.encrypt(GOST_28147_89::Method::ECB, std::as_bytes(std::span(plaintext)),
+                  std::as_writable_bytes(std::span(encrypted)));
+
+    assert(encrypted == ciphertext);
+    std::cout << "[ SUCCESS ] Known answer test passed for TC26 Z" << std::endl
+              << std::endl;
+}
+
+void testIncremental(const std::string& plaintext, GOST_28147_89::Method method,
+                     const GOST_28147_89& gost)
+{
+    std::array<std::byte, 64> expected;
+    gost.encrypt(method, std::as_bytes(std::span(plaintext)), expected);
+
+    // Подаем сообщение частями по 3 байта.
+    GOST_28147_89::Context context(gost, method, true);
+    std::array<std::byte, 64> encrypted;
+    size_t size = 0;
+    for (size_t i = 0; i < plaintext.size(); i += 3) {
+        const auto part = std::as_bytes(std::span(plaintext)).subspan(i).first(
+            std::min<size_t>(3, plaintext.size() - i));
+        size += context.update(part, std::span(encrypted).subspan(size));
+    }
+    size += context.final(std::span(encrypted).subspan(size));
+
+    assert(size == plaintext.size());
+    assert(std::memcmp(encrypted.data(), expected.data(), size) == 0);
+
+    // Пустое сообщение в режимах с дополнением дает один блок, как и encrypt.
+    for (const auto padded : { GOST_28147_89::Method::ECB, GOST_28147_89::Method::CBC }) {
+        std::array<std::byte, 8> one_shot, incremental;
+        const size_t one_shot_size =
+            gost.encrypt(padded, std::span<const std::byte>(), one_shot);
+        GOST_28147_89::Context empty(gost, padded, true);
+        const size_t incremental_size =
+            empty.update({}, incremental) + empty.final(incremental);
+        assert(one_shot_size == 8 && incremental_size == 8 && incremental == one_shot);
+    }
+    std::cout << "[ SUCCESS ] Incremental test passed for method "
+              << static_cast<int>(method) << std::endl
+              << std::endl;
+}
+
+void testCounterRange(const std::string& plaintext, const GOST_28147_89& gost)
+{
+    std::array<std::byte, 64> encrypted;
+    gost.encrypt(GOST_28147_89::Method::CTR, std::as_bytes(std::span(plaintext)),
+                 encrypted);
+
+    // Каждый диапазон расшифровывается отдельно, без обработки предшествующих байт.
+    for (size_t offset = 0; offset < plaintext.size(); ++offset) {
+        for (size_t length = 0; offset + length <= plaintext.size(); ++length) {
+            std::array<std::byte, 64> decrypted;
+            gost.processCounterRange(offset, std::span(encrypted).subspan(offset, length),
+                                     decrypted);
+            assert(std::memcmp(decrypted.data(), plaintext.data() + offset, length) == 0);
+        }
+    }
+    std::cout << "[ SUCCESS ] Counter range test passed" << std::endl << std::endl;
+}
+
+void testMac(const std::string& plaintext, GOST_28147_89::Method method,
+             GOST_28147_89& gost)
+{
+    std::istringstream input_stream(plaintext);
+    std::ostringstream encrypted_stream;
+    const auto mac = gost.encryptWithMac(method, input_stream, encrypted_stream);
+
+    std::istringstream encrypted_input(encrypted_stream.str());
+    std::ostringstream decrypted_stream;
+    assert(gost.decryptWithMac(method, encrypted_input, decrypted_stream) == mac);
+
+    // Проверка без шифрования и по данным в памяти.
+    std::istringstream plain_input(plaintext);
+    assert(gost.computeMac(plain_input) == mac);
+    assert(gost.computeMac(std::as_bytes(std::span(plaintext))) == mac);
+
+    // Изменение одного бита открытого текста меняет имитовставку.
+    std::string changed = plaintext;
+    changed[0] ^= 1;
+    assert(gost.computeMac(std::as_bytes(std::span(changed))) != mac);
+
+    std::cout << "[ SUCCESS ] MAC test passed for method " << static_cast<int>(method)
+              << std::endl
+              << std::endl;
+}
+
+void testBatch(GOST_28147_89::Method method, GOST_28147_89& gost)
+{
+    // Сообщения разной длины, каждое со своим вектором инициализации.
+    const std::array<std::string, 3> records = { "first", "second record",
+                                                 "the third, longest record" };
+    const std::array<const char*, 3> ivs     = { "iv000001", "iv000002", "iv000003" };
+
+    std::array<std::array<std::byte, 32>, 3> encrypted;
+    std::array<GOST_28147_89::Message, 3> messages;
+    for (size_t i = 0; i < records.size(); ++i) {
+        messages[i].input  = std::as_bytes(std::span(records[i]));
+        messages[i].output = encrypted[i];
+        std::memcpy(messages[i].iv.data(), ivs[i], messages[i].iv.size());
+    }
+    gost.encryptBatch(method, messages);
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        std::array<std::byte, 32> expected;
+        gost.setInitializationVector(ivs[i]);
+        const size_t size = gost.encrypt(method, messages[i].input, expected);
+        assert(std::memcmp(encrypted[i].data(), expected.data(), size) == 0);
+    }
+    std::cout << "[ SUCCESS ] Batch test passed for method " << static_cast<int>(method)
+              << std::endl
+              << std::endl;
+}
+
+void testKeystream(const std::string& plaintext, GOST_28147_89::Method method,
+                   const GOST_28147_89& gost)
+{
+    std::array<std::byte, 64> expected;
+    gost.encrypt(method, std::as_bytes(std::span(plaintext)), expected);
+
+    // Гамма вырабатывается в фоновом потоке; данные поступают частями по 5 байт.
+    GOST_28147_89::Keystream keystream(gost, method);
+    std::array<std::byte, 64> encrypted;
+    for (size_t i = 0; i < plaintext.size(); i += 5) {
+        const size_t size = std::min<size_t>(5, plaintext.size() - i);
+        keystream.apply(std::as_bytes(std::span(plaintext)).subspan(i, size),
+                        std::span(encrypted).subspan(i, size));
+    }
+
+    assert(std::memcmp(encrypted.data(), expected.data(), plaintext.size()) == 0);
+    std::cout << "[ SUCCESS ] Keystream test passed for method "
+              << static_cast<int>(method) << std::endl
+              << std::endl;
+}
+
+void testSharedCipher(GOST_28147_89::Method method, const GOST_28147_89& gost)
+{
+    // Один объект шифра используется всеми потоками; вектор инициализации задается
+    // для каждой операции, а результат совпадает с последовательной обработкой.
+    const std::string plaintext = "One keyed cipher, many threads.";
+    std::array<std::array<std::byte, 32>, 4> expected;
+    std::array<std::array<std::byte, 32>, 4> encrypted;
+    std::array<GOST_28147_89::block_t, 4> ivs;
+    for (size_t i = 0; i < ivs.size(); ++i) {
+        ivs[i] = { 1, 2, 3, 4, 5, 6, 7, static_cast<unsigned char>(i) };
+        gost.encrypt(method, ivs[i], std::as_bytes(std::span(plaintext)), expected[i]);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ivs.size(); ++i)
+        threads.emplace_back(
+            [&, i]
+            {
+                gost.encrypt(method, ivs[i], std::as_bytes(std::span(plaintext)),
+                             encrypted[i]);
+            });
+    for (auto& thread : threads)
+        thread.join();
+
+    assert(encrypted == expected);
+    std::cout << "[ SUCCESS ] Shared cipher test passed for method "
+              << static_cast<int>(method) << std::endl
+              << std::endl;
+}
+
+void testKeyCache(GOST_28147_89::Method method, const GOST_28147_89& gost)
+{
+    // Шифр из кэша совпадает с шифром, созданным напрямую; при переполнении
+    // вытесняется ключ, который дольше всех не использовался.
+    const std::string plaintext = "Thousands of tenants, a few hot keys.";
+    const GOST_28147_89::block_t iv = { 8, 7, 6, 5, 4, 3, 2, 1 };
+    size_t loads = 0;
+    const auto load = [&](const std::string& key_id)
+    {
+        ++loads;
+        KeyCache<>::key_t key;
+        for (size_t i = 0; i < key.size(); ++i)
+            key[i] = static_cast<std::byte>(key_id == "main" ? 'A' + i % 24 : i);
+        return key;
+    };
+
+    KeyCache<> cache(2);
+    const auto cipher = cache.get("main", load);
+    cache.get("other", load);
+    assert(cache.get("main", load) == cipher && loads == 2);
+
+    std::array<std::byte, 40> expected, encrypted;
+    gost.encrypt(method, iv, std::as_bytes(std::span(plaintext)), expected);
+    cipher->encrypt(method, iv, std::as_bytes(std::span(plaintext)), encrypted);
+    assert(encrypted == expected);
+
+    // Общий шифр из кэша вырабатывает имитовставку и читает диапазон потока с
+    // вектором инициализации, переданным операции.
+    const auto input = std::as_bytes(std::span(plaintext));
+    GOST_28147_89::block_t mac, expected_mac;
+    gost.encryptWithMac(method, iv, input, expected, expected_mac);
+    cipher->encryptWithMac(method, iv, input, encrypted, mac);
+    assert(encrypted == expected && mac == expected_mac);
+
+    const size_t offset = 13;
+    std::array<std::byte, 40> range;
+    cipher->encrypt(GOST_28147_89::Method::CTR, iv, input, expected);
+    cipher->processCounterRange(iv, offset, input.subspan(offset), range);
+    assert(std::equal(expected.begin() + offset, expected.begin() + input.size(),
+                      range.begin()));
+
+    cache.get("third", load);
+    assert(cache.size() == 2 && cache.find("main") && !cache.find("other"));
+    std::cout << "[ SUCCESS ] Key cache test passed for method "
+              << static_cast<int>(method) << std::endl
+              << std::endl;
+}
+
+void testMissingFile(GOST_28147_89& gost)
+{
+    // Отсутствующий входной файл - ошибка при любом способе ввода-вывода, и пустой
+    // выходной файл не создается.
+    for (const auto file_io : { GOST_28147_89::FileIo::Pipeline,
+                                GOST_28147_89::FileIo::DirectPipeline,
+                                GOST_28147_89::FileIo::Mapped }) {
+        gost.setFileIo(file_io);
+        bool thrown = false;
+        try {
+            gost.encryptFile("missing_test.bin");
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown && !std::filesystem::exists("missing_test_encrypted.bin"));
+    }
+    gost.setFileIo(GOST_28147_89::FileIo::Pipeline);
+    std::cout << "[ SUCCESS ] Missing file test passed" << std::endl << std::endl;
+}
+
+void testContainer(GOST_28147_89::Method method, GOST_28147_89& gost)
+{
+    // Контейнер из участков по 64 байта: расшифрование возвращает исходную длину,
+    // диапазон читается без расшифрования всего файла, прерванная запись
+    // продолжается, а измененный участок обнаруживается по имитовставке.
+    std::string plaintext;
+    for (size_t i = 0; i < 1000; ++i)
+        plaintext += static_cast<char>('a' + i % 26);
+    std::ofstream("container_test.bin", std::ios::binary) << plaintext;
+
+    gost.setChunkSize(64);
+    gost.setFileFormat(GOST_28147_89::FileFormat::Container, method);
+    gost.encryptFile("container_test.bin");
+    gost.decryptFile("container_test_encrypted.bin");
+
+    auto read = [](const char* filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+    const std::string container = read("container_test_encrypted.bin");
+    assert(read("container_test_plaintext.bin") == plaintext);
+
+    std::array<std::byte, 300> range;
+    const size_t range_size =
+        gost.readContainer("container_test_encrypted.bin", 100, range);
+    assert(range_size == 300);
+    assert(std::memcmp(range.data(), plaintext.data() + 100, range.size()) == 0);
+
+    std::filesystem::resize_file("container_test_encrypted.bin", 300);
+    gost.encryptFile("container_test.bin");
+    assert(read("container_test_encrypted.bin") == container);
+
+    // Запись, прерванная с другим ключом, не продолжается: контейнер записывается
+    // заново, и прежний ключ его не расшифровывает.
+    GOST_28147_89 other("ZYXWVUTSRQPONMLKJIHGFEDCBAZYXWVU");
+    other.setInitializationVector("abcdefgh");
+    other.setChunkSize(64);
+    other.setFileFormat(GOST_28147_89::FileFormat::Container, method);
+    std::filesystem::resize_file("container_test_encrypted.bin", 300);
+    other.encryptFile("container_test.bin");
+    other.decryptFile("container_test_encrypted.bin");
+    assert(read("container_test_plaintext.bin") == plaintext);
+    bool rejected = false;
+    try {
+        gost.decryptFile("container_test_encrypted.bin");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+    gost.encryptFile("container_test.bin");
+    assert(read("container_test_encrypted.bin") == container);
+
+    // Изменение участка или заголовка (здесь - неиспользуемого бита флагов)
+    // обнаруживается по имитовставке. Прежний результат расшифрования не
+    // заменяется участками, расшифрованными до ошибки.
+    for (const size_t position : { 200, 7 }) {
+        std::string tampered = container;
+        tampered[position] ^= 4;
+        std::ofstream("container_test_encrypted.bin", std::ios::binary) << tampered;
+        bool detected = false;
+        try {
+            gost.decryptFile("container_test_encrypted.bin");
+        } catch (const std::runtime_error&) {
+            detected = true;
+        }
+        assert(detected && read("container_test_plaintext.bin") == plaintext);
+        assert(!std::filesystem::exists("container_test_plaintext.bin.partial"));
+    }
+
+    // Два контейнера записываются одновременно общим шифром с пулом потоков:
+    // участки шифруются задачами пула, а вложенное распараллеливание участка в
+    // режиме CTR не ждет занятых потоков пула.
+    std::string large;
+    for (size_t i = 0; i < 256 * 1024; ++i)
+        large += static_cast<char>(i * 31 + i / 7);
+    std::ofstream("container_test.bin", std::ios::binary) << large;
+    std::ofstream("container_test2.bin", std::ios::binary) << large;
+    gost.setChunkSize(64 * 1024);
+    gost.setFileFormat(GOST_28147_89::FileFormat::Container, GOST_28147_89::Method::CTR);
+    gost.setThreadCount(2);
+    std::thread writer([&] { gost.encryptFile("container_test2.bin"); });
+    gost.encryptFile("container_test.bin");
+    writer.join();
+    gost.setThreadCount(1);
+    gost.decryptFile("container_test2_encrypted.bin");
+    assert(read("container_test2_plaintext.bin") == large);
+
+    gost.setFileFormat(GOST_28147_89::FileFormat::Raw);
+    for (const char* filename :
+         { "container_test.bin", "container_test_encrypted.bin",
+           "container_test_plaintext.bin", "container_test2.bin",
+           "container_test2_encrypted.bin", "container_test2_plaintext.bin" })
+        std::filesystem::remove(filename);
+    std::cout << "[ SUCCESS ] Container test passed for method "
+              << static_cast<int>(method) << std::endl
+              << std::endl;
+}
+
+void testLz4()
+{
+    // Сжатые данные распаковываются только в буфер исходного размера; усеченные и
+    // поврежденные блоки отвергаются без выхода за границы буферов.
+    std::string text;
+    for (size_t i = 0; i < 200; ++i)
+        text += "level=info msg=\"request served\" id=" + std::to_string(i) + "\n";
+    const auto input = std::as_bytes(std::span(text));
+    std::vector<std::byte> compressed(input.size()), output(input.size());
+    const size_t size = Lz4::compress(input, compressed);
+    assert(size > 0 && size < input.size() / 2);
+    compressed.resize(size);
+
+    const bool restored = Lz4::decompress(compressed, output);
+    assert(restored && std::equal(output.begin(), output.end(), input.begin()));
+    const bool shorter =
+        Lz4::decompress(compressed, { output.data(), output.size() - 1 });
+    assert(!shorter);
+    for (size_t length = 0; length < size; ++length) {
+        const bool truncated = Lz4::decompress({ compressed.data(), length }, output);
+        assert(!truncated);
+    }
+
+    // Ссылка на данные перед началом блока, нулевое смещение и длина литералов,
+    // оборванная посреди кодирования.
+    auto bytes = [](std::initializer_list<int> values)
+    {
+        std::vector<std::byte> block;
+        for (int value : values)
+            block.push_back(static_cast<std::byte>(value));
+        return block;
+    };
+    std::array<std::byte, 64> buffer;
+    for (const auto& block :
+         { bytes({ 0x10, 'a', 0x02, 0x00, 0x00 }), bytes({ 0x10, 'a', 0x00, 0x00, 0x00 }),
+           bytes({ 0xF0, 0xFF, 0xFF }) }) {
+        const bool malformed = Lz4::decompress(block, buffer);
+        assert(!malformed);
+    }
+    std::cout << "[ SUCCESS ] LZ4 test passed, " << input.size() << " -> " << size
+              << " bytes" << std::endl
+              << std::endl;
+}
+
+void testCompressedContainer(GOST_28147_89& gost)
+{
+    // Сжимаемые участки сохраняются сжатыми, несжимаемые - как есть; расшифрование
+    // и чтение диапазона возвращают исходные данные.
+    std::string plaintext;
+    for (size_t i = 0; plaintext.size() < 40000; ++i)
+        plaintext += "2026-10-17," + std::to_string(i % 97) + ",GET /api/items,"
+                     + std::to_string(i * 7 % 1000) + "\n";
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        plaintext += static_cast<char>(seed >> 16);
+    }
+    std::ofstream("compressed_test.bin", std::ios::binary) << plaintext;
+
+    gost.setChunkSize(4096);
+    gost.setFileFormat(GOST_28147_89::FileFormat::Container, GOST_28147_89::Method::CTR,
+                       true, true);
+    gost.encryptFile("compressed_test.bin");
+    gost.decryptFile("compressed_test_encrypted.bin");
+
+    std::ifstream decrypted("compressed_test_plaintext.bin", std::ios::binary);
+    assert(std::string(std::istreambuf_iterator<char>(decrypted), {}) == plaintext);
+    const size_t container_size =
+        std::filesystem::file_size("compressed_test_encrypted.bin");
+    assert(container_size < plaintext.size() / 2);
+
+    std::array<std::byte, 6000> range;
+    const size_t range_size =
+        gost.readContainer("compressed_test_encrypted.bin", 38000, range);
+    assert(range_size == 6000);
+    assert(std::memcmp(range.data(), plaintext.data() + 38000, range.size()) == 0);
+
+    // Прерванная запись продолжается после сохраненных записей, а не начинается
+    // заново: байт, измененный в первой записи, остается измененным.
+    auto read = []
+    {
+        std::ifstream file("compressed_test_encrypted.bin", std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+    const std::string container = read();
+    std::string interrupted     = container.substr(0, container_size / 2);
+    interrupted[48] ^= 1;
+    std::ofstream("compressed_test_encrypted.bin", std::ios::binary) << interrupted;
+    gost.encryptFile("compressed_test.bin");
+    std::string resumed = read();
+    assert(resumed != container);
+    resumed[48] ^= 1;
+    assert(resumed == container);
+
+    // Снятый в заголовке флаг имитовставки не отключает проверку: шифр, которому
+    // заданы имитовставки, такой контейнер не открывает.
+    std::string stripped = container;
+    stripped[7] &= ~1;
+    stripped[60] ^= 1;
+    std::ofstream("compressed_test_encrypted.bin", std::ios::binary) << stripped;
+    bool rejected = false;
+    try {
+        gost.decryptFile("compressed_test_encrypted.bin");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // При длине, кратной размеру участка, прерванная перед оглавлением запись
+    // сохраняет все участки, включая последний, и дописывается только оглавлением.
+    const std::string exact = plaintext.substr(0, 10 * 4096);
+    std::ofstream("compressed_test.bin", std::ios::binary) << exact;
+    gost.encryptFile("compressed_test.bin");
+    const std::string complete = read();
+    std::string unindexed      = complete.substr(0, complete.size() - 10 * 16 - 24);
+    unindexed.back() ^= 1;
+    std::ofstream("compressed_test_encrypted.bin", std::ios::binary) << unindexed;
+    gost.encryptFile("compressed_test.bin");
+    std::string indexed = read();
+    assert(indexed != complete);
+    indexed[unindexed.size() - 1] ^= 1;
+    assert(indexed == complete);
+
+    gost.setFileFormat(GOST_28147_89::FileFormat::Raw);
+    gost.setChunkSize(64 * 1024);
+    for (const char* filename : { "compressed_test.bin", "compressed_test_encrypted.bin",
+                                  "compressed_test_plaintext.bin" })
+        std::filesystem::remove(filename);
+    std::cout << "[ SUCCESS ] Compressed container test passed, " << plaintext.size()
+              << " -> " << container_size << " bytes" << std::endl
+              << std::endl;
+}
+
+void testKernels(const GOST_28147_89& gost)
+{
+    // Каждое ядро, прошедшее самопроверку, дает тот же шифротекст, что и скалярное.
+    std::array<std::byte, 8 * 67> plaintext, expected, encrypted;
+    for (size_t i = 0; i < plaintext.size(); ++i)
+        plaintext[i] = static_cast<std::byte>(i * 7);
+
+    const std::string selected = GOST_28147_89::kernel();
+    const bool scalar          = GOST_28147_89::setKernel("scalar");
+    assert(scalar);
+    gost.encrypt(GOST_28147_89::Method::ECB, plaintext, expected);
+    for (const auto& kernel : GOST_28147_89::kernels()) {
+        std::cout << "Kernel " << kernel.name << ": "
+                  << (kernel.verified ? "enabled" : "unavailable") << std::endl;
+        const bool enabled = GOST_28147_89::setKernel(kernel.name);
+        assert(enabled == kernel.verified);
+        gost.encrypt(GOST_28147_89::Method::ECB, plaintext, encrypted);
+        assert(encrypted == expected);
+    }
+    const bool unknown = GOST_28147_89::setKernel("unknown");
+    assert(!unknown);
+    const bool automatic = GOST_28147_89::setKernel("auto");
+    assert(automatic && GOST_28147_89::kernel() == selected);
+    std::cout << "[ SUCCESS ] Kernel test passed, selected " << selected << std::endl
+              << std::endl;
+}
+
+void testJit(const GOST_28147_89& gost)
+{
+    // Код, сгенерированный для ключа, дает тот же результат, что и общий путь, в том
+    // числе после смены ключа. Счетчик переходит через 2^32.
+    GOST_28147_89 jit = gost;
+    if (!jit.setJit(true)) {
+        std::cout << "[ SKIPPED ] JIT is not available on this platform" << std::endl
+                  << std::endl;
+        return;
+    }
+    assert(jit.jitEnabled() && !gost.jitEnabled());
+
+    GOST_28147_89 reference = gost;
+    const GOST_28147_89::block_t iv = { 0, 0, 0, 1, 0xFF, 0xFF, 0xFF, 0xFA };
+    std::array<std::byte, 8 * 37 + 5> plaintext;
+    for (size_t i = 0; i < plaintext.size(); ++i)
+        plaintext[i] = static_cast<std::byte>(i * 13);
+
+    for (const char* key :
+         { "ABCDEFGHIJKLMNOPQRSTUVWXABCDEFGH", "Long-lived volume key, 32 bytes." }) {
+        jit.rekey(key);
+        reference.rekey(key);
+        for (const auto method : { GOST_28147_89::Method::ECB, GOST_28147_89::Method::CBC,
+                                   GOST_28147_89::Method::CTR }) {
+            std::array<std::byte, GOST_28147_89::outputSize(plaintext.size())> expected,
+                encrypted, decrypted;
+            reference.encrypt(method, iv, plaintext, expected);
+            jit.encrypt(method, iv, plaintext, encrypted);
+            assert(encrypted == expected);
+            jit.decrypt(method, iv, encrypted, decrypted);
+            assert(std::equal(plaintext.begin(), plaintext.end(), decrypted.begin()));
+        }
+    }
+    assert(jit.jitEnabled());
+    const bool still_used = jit.setJit(false);
+    assert(!still_used && !jit.jitEnabled());
+    std::cout << "[ SUCCESS ] JIT test passed" << std::endl << std::endl;
+}
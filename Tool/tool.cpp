@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GOST_28147_89.h"
+
+// Параллельное шифрование множества файлов ГОСТ 28147-89.
+//
+// Файлы берутся из каталогов (рекурсивно), из аргументов командной строки и из
+// списков (по одному пути в строке) и распределяются между потоками планировщика с
+// перехватом задач (work stealing). Большие файлы делятся на участки, которые
+// обрабатываются независимо, чтобы один огромный файл не задерживал завершение всей
+// работы. Результат каждого файла совпадает с результатом encrypt/decrypt для
+// потоков с тем же режимом и вектором инициализации. Пример:
+//     gost_tool --key backup.key --iv 0102030405060708 --method ctr
+//               --output /backup/encrypted /data /etc/hosts --list files.txt
+
+namespace
+{
+    using Method  = GOST_28147_89::Method;
+    using block_t = GOST_28147_89::block_t;
+
+    // Размер порции, которой обрабатывается участок файла.
+    constexpr size_t PORTION_SIZE = 1 << 20;
+
+    struct Options
+    {
+        bool decrypt  = false;
+        Method method = Method::CTR;
+        std::string key_filename;
+        block_t iv {};
+        bool has_iv = false;
+        std::filesystem::path output;
+        // Файлы больше split_size делятся на участки этого размера.
+        size_t split_size = 32 << 20;
+        size_t threads    = 0;
+        std::vector<std::string> inputs;
+        std::vector<std::string> lists;
+    };
+
+    /**
+     * Файл для обработки и путь результата.
+     */
+    struct Job
+    {
+        std::filesystem::path input;
+        std::filesystem::path output;
+        uint64_t size = 0;
+    };
+
+    /**
+     * Задача планировщика: весь файл или его участок [offset, offset + length).
+     */
+    struct Task
+    {
+        const Job* job  = nullptr;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        bool whole      = true;
+    };
+
+    /**
+     * Планировщик с перехватом задач. Каждый поток берет задачи из начала своей
+     * очереди, а опустев, забирает задачи из конца чужих. Задачи не порождают новых,
+     * поэтому поток, не нашедший задачи ни в одной очереди, завершается.
+     */
+    class WorkStealingPool
+    {
+    public:
+        /**
+         * @param thread_count - количество потоков (0 - по числу ядер процессора).
+         */
+        explicit WorkStealingPool(size_t thread_count)
+            : m_queues(thread_count == 0
+                           ? std::max(1u, std::thread::hardware_concurrency())
+                           : thread_count)
+        {
+        }
+
+        size_t size() const { return m_queues.size(); }
+
+        /**
+         * Выполняет process для всех задач и дожидается завершения. Задачи
+         * раздаются очередям по кругу в заданном порядке, поэтому задачи,
+         * отсортированные по убыванию стоимости, распределяются равномерно. Первый
+         * поток - вызывающий.
+         */
+        void run(const std::vector<Task>& tasks,
+                 const std::function<void(const Task&)>& process)
+        {
+            for (size_t i = 0; i < tasks.size(); ++i)
+                m_queues[i % m_queues.size()].tasks.push_back(tasks[i]);
+
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < m_queues.size(); ++i)
+                workers.emplace_back([this, i, &process] { workerLoop(i, process); });
+            workerLoop(0, process);
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        /**
+         * @return Количество задач, выполненных не своим потоком.
+         */
+        size_t stolen() const { return m_stolen.load(); }
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void workerLoop(size_t index, const std::function<void(const Task&)>& process)
+        {
+            Task task;
+            while (pop(index, task) || steal(index, task))
+                process(task);
+        }
+
+        bool pop(size_t index, Task& task)
+        {
+            Queue& queue = m_queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                return false;
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+
+        bool steal(size_t index, Task& task)
+        {
+            for (size_t i = 1; i < m_queues.size(); ++i) {
+                Queue& victim = m_queues[(index + i) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.tasks.empty())
+                    continue;
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                ++m_stolen;
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<Queue> m_queues;
+        std::atomic<size_t> m_stolen { 0 };
+    };
+
+    size_t parseSize(const std::string& text)
+    {
+        size_t pos        = 0;
+        const size_t size = std::stoull(text, &pos);
+        switch (pos < text.size() ? text[pos] : '\0') {
+            case 'K':
+            case 'k': return size << 10;
+            case 'M':
+            case 'm': return size << 20;
+            case 'G':
+            case 'g': return size << 30;
+            default: return size;
+        }
+    }
+
+    Method parseMethod(const std::string& text)
+    {
+        const std::vector<std::pair<std::string, Method>> methods = {
+            { "ecb", Method::ECB }, { "cbc", Method::CBC }, { "cfb", Method::CFB },
+            { "ofb", Method::OFB }, { "ctr", Method::CTR },
+        };
+        for (const auto& [name, method] : methods)
+            if (name == text)
+                return method;
+        throw std::invalid_argument("Unknown method: " + text);
+    }
+
+    /**
+     * Разбирает вектор инициализации, заданный 16 шестнадцатеричными цифрами.
+     */
+    block_t parseIv(const std::string& text)
+    {
+        if (text.size() != 16
+            || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            throw std::invalid_argument("IV must be 16 hex digits.");
+        block_t iv;
+        for (size_t i = 0; i < iv.size(); ++i)
+            iv[i] = static_cast<unsigned char>(
+                std::stoul(text.substr(2 * i, 2), nullptr, 16));
+        return iv;
+    }
+
+    /**
+     * Читает ключ (ровно 32 байта) из файла.
+     */
+    std::array<std::byte, 32> readKey(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        std::array<std::byte, 32> key;
+        if (!file.read(reinterpret_cast<char*>(key.data()), key.size())
+            || file.peek() != std::ifstream::traits_type::eof())
+            throw std::runtime_error("Key file must contain exactly 32 bytes: "
+                                     + filename);
+        return key;
+    }
+
+    void usage(const char* program)
+    {
+        std::cerr << "Usage: " << program
+                  << " --key FILE --iv HEX16 --output DIR [--decrypt]"
+                     " [--method ecb|cbc|cfb|ofb|ctr] [--threads N] [--split 32M]"
+                     " [--list FILE]... [FILE|DIR]..."
+                  << std::endl;
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool has_value  = i + 1 < argc;
+            try {
+                if (arg == "--decrypt") {
+                    options.decrypt = true;
+                } else if (arg == "--method" && has_value) {
+                    options.method = parseMethod(argv[++i]);
+                } else if (arg == "--key" && has_value) {
+                    options.key_filename = argv[++i];
+                } else if (arg == "--iv" && has_value) {
+                    options.iv     = parseIv(argv[++i]);
+                    options.has_iv = true;
+                } else if (arg == "--output" && has_value) {
+                    options.output = argv[++i];
+                } else if (arg == "--split" && has_value) {
+                    // Участки начинаются на границах блоков.
+                    options.split_size =
+                        std::max<size_t>(8, parseSize(argv[++i]) & ~size_t(7));
+                } else if (arg == "--threads" && has_value) {
+                    options.threads = std::stoul(argv[++i]);
+                } else if (arg == "--list" && has_value) {
+                    options.lists.push_back(argv[++i]);
+                } else if (!arg.empty() && arg[0] != '-') {
+                    options.inputs.push_back(arg);
+                } else {
+                    usage(argv[0]);
+                    std::exit(arg == "--help" ? 0 : 1);
+                }
+            } catch (const std::logic_error& e) {
+                // Ошибки разбора значений (parseMethod, parseIv, std::stoul и др.).
+                std::cerr << "Invalid value of " << arg << " '" << argv[i]
+                          << "': " << e.what() << std::endl;
+                usage(argv[0]);
+                std::exit(1);
+            }
+        }
+        if (options.key_filename.empty() || !options.has_iv || options.output.empty()
+            || (options.inputs.empty() && options.lists.empty())) {
+            usage(argv[0]);
+            std::exit(1);
+        }
+        return options;
+    }
+
+    /**
+     * Путь результата: относительный путь входного файла внутри выходного каталога.
+     * Для файлов из каталога путь берется относительно этого каталога, для остальных
+     * - сам путь без корня.
+     */
+    std::filesystem::path outputPath(const std::filesystem::path& output,
+                                     const std::filesystem::path& input,
+                                     const std::filesystem::path& root)
+    {
+        if (!root.empty())
+            return output / root.filename() / input.lexically_relative(root);
+        return output / input.lexically_normal().relative_path();
+    }
+
+    void addFile(std::vector<Job>& jobs, const Options& options,
+                 const std::filesystem::path& input, const std::filesystem::path& root)
+    {
+        jobs.push_back({ input, outputPath(options.output, input, root),
+                         std::filesystem::file_size(input) });
+    }
+
+    void addPath(std::vector<Job>& jobs, const Options& options,
+                 const std::filesystem::path& path)
+    {
+        if (!std::filesystem::is_directory(path)) {
+            addFile(jobs, options, path, {});
+            return;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+            if (entry.is_regular_file())
+                addFile(jobs, options, entry.path(), path);
+    }
+
+    std::vector<Job> collectJobs(const Options& options)
+    {
+        std::vector<Job> jobs;
+        for (const auto& input : options.inputs)
+            addPath(jobs, options, input);
+        for (const auto& list : options.lists) {
+            std::ifstream file(list);
+            if (!file)
+                throw std::runtime_error("Failed to open file list: " + list);
+            for (std::string line; std::getline(file, line);)
+                if (!line.empty())
+                    addPath(jobs, options, line);
+        }
+        return jobs;
+    }
+
+    /**
+     * Участки файла можно обрабатывать независимо, если состояние в начале участка
+     * вычисляется без обработки предшествующих данных: в режимах ECB и CTR (значение
+     * счетчика), а при расшифровании CBC и CFB - по предыдущему блоку шифротекста.
+     */
+    bool canSplit(Method method, bool decrypt)
+    {
+        return method == Method::ECB || method == Method::CTR
+               || (decrypt && (method == Method::CBC || method == Method::CFB));
+    }
+
+    /**
+     * Значение счетчика CTR для блока с номером index.
+     */
+    block_t counterAt(const block_t& iv, uint64_t index)
+    {
+        uint64_t counter = 0;
+        for (const auto byte : iv)
+            counter = counter << 8 | byte;
+        if (counter > UINT64_MAX - index)
+            throw std::runtime_error("Counter overflow detected");
+        counter += index;
+        block_t block;
+        for (size_t i = block.size(); i-- > 0; counter >>= 8)
+            block[i] = static_cast<unsigned char>(counter);
+        return block;
+    }
+
+    /**
+     * Обрабатывает целый файл потоковыми функциями шифра.
+     */
+    void processWhole(const GOST_28147_89& gost, const Options& options, const Job& job)
+    {
+        std::filesystem::create_directories(job.output.parent_path());
+        std::ifstream input(job.input, std::ios::binary);
+        std::ofstream output(job.output, std::ios::binary);
+        if (!input || !output)
+            throw std::runtime_error("Failed to open " + job.input.string());
+        if (options.decrypt)
+            gost.decrypt(options.method, options.iv, input, output);
+        else
+            gost.encrypt(options.method, options.iv, input, output);
+        if (!output.flush())
+            throw std::runtime_error("Failed to write " + job.output.string());
+    }
+
+    /**
+     * Обрабатывает участок файла порциями. Состояние в начале каждой порции
+     * вычисляется по ее смещению (см. canSplit), поэтому порции и участки не зависят
+     * друг от друга, а результат совпадает с обработкой всего файла. Выходной файл
+     * создан заранее.
+     */
+    void processRange(const GOST_28147_89& gost, const Options& options, const Task& task)
+    {
+        const Job& job = *task.job;
+        std::ifstream input(job.input, std::ios::binary);
+        std::fstream output(job.output, std::ios::in | std::ios::out | std::ios::binary);
+        if (!input || !output)
+            throw std::runtime_error("Failed to open " + job.input.string());
+
+        // Перед порцией читается предыдущий блок: при расшифровании CBC и CFB он
+        // служит вектором инициализации порции.
+        std::vector<std::byte> buffer(8 + PORTION_SIZE);
+        std::vector<std::byte> result(PORTION_SIZE);
+        const uint64_t end = task.offset + task.length;
+        for (uint64_t offset = task.offset; offset < end; offset += PORTION_SIZE) {
+            const size_t size =
+                static_cast<size_t>(std::min<uint64_t>(PORTION_SIZE, end - offset));
+            const size_t extra = offset == 0 ? 0 : 8;
+            input.seekg(static_cast<std::streamoff>(offset - extra));
+            if (!input.read(reinterpret_cast<char*>(buffer.data()),
+                            static_cast<std::streamsize>(extra + size)))
+                throw std::runtime_error("Failed to read " + job.input.string());
+
+            block_t iv = options.iv;
+            if (options.method == Method::CTR)
+                iv = counterAt(options.iv, offset / 8);
+            else if (extra != 0)
+                std::memcpy(iv.data(), buffer.data(), 8);
+
+            const std::span<const std::byte> data(buffer.data() + extra, size);
+            const size_t written = options.decrypt
+                                       ? gost.decrypt(options.method, iv, data, result)
+                                       : gost.encrypt(options.method, iv, data, result);
+            output.seekp(static_cast<std::streamoff>(offset));
+            if (!output.write(reinterpret_cast<const char*>(result.data()),
+                              static_cast<std::streamsize>(written)))
+                throw std::runtime_error("Failed to write " + job.output.string());
+        }
+    }
+
+    /**
+     * Создает выходной файл для файла, делимого на участки, сразу полной длины.
+     */
+    void createOutput(const Job& job)
+    {
+        std::filesystem::create_directories(job.output.parent_path());
+        std::ofstream(job.output, std::ios::binary);
+        std::filesystem::resize_file(job.output, GOST_28147_89::outputSize(job.size));
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Options options = parseOptions(argc, argv);
+
+    try {
+        auto key = readKey(options.key_filename);
+        const GOST_28147_89 gost(key);
+        GOST_28147_89::secureWipe(key.data(), key.size());
+
+        // Крупные файлы идут первыми: раздача по кругу распределяет их между потоками,
+        // а мелкие файлы выравнивают нагрузку в конце.
+        std::vector<Job> jobs = collectJobs(options);
+        std::sort(jobs.begin(), jobs.end(),
+                  [](const Job& a, const Job& b) { return a.size > b.size; });
+
+        std::vector<Task> tasks;
+        uint64_t total = 0;
+        for (const Job& job : jobs) {
+            total += job.size;
+            if (job.size <= options.split_size
+                || !canSplit(options.method, options.decrypt)) {
+                tasks.push_back({ &job, 0, job.size, true });
+                continue;
+            }
+            createOutput(job);
+            for (uint64_t offset = 0; offset < job.size; offset += options.split_size)
+                tasks.push_back(
+                    { &job, offset,
+                      std::min<uint64_t>(options.split_size, job.size - offset), false });
+        }
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b)
+                         { return a.length > b.length; });
+
+        std::atomic<size_t> failed { 0 };
+        std::mutex error_mutex;
+        WorkStealingPool pool(options.threads);
+        const auto start = std::chrono::steady_clock::now();
+        pool.run(tasks,
+                 [&](const Task& task)
+                 {
+                     try {
+                         if (task.whole)
+                             processWhole(gost, options, *task.job);
+                         else
+                             processRange(gost, options, task);
+                     } catch (const std::exception& e) {
+                         ++failed;
+                         std::lock_guard<std::mutex> lock(error_mutex);
+                         std::cerr << task.job->input.string() << ": " << e.what()
+                                   << std::endl;
+                     }
+                 });
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+        std::printf("%zu files, %zu tasks (%zu stolen), %zu threads, %llu bytes, "
+                    "%.3f s, %.2f MB/s\n",
+                    jobs.size(), tasks.size(), pool.stolen(), pool.size(),
+                    static_cast<unsigned long long>(total), seconds,
+                    seconds > 0 ? total / seconds / 1e6 : 0.0);
+        if (failed != 0) {
+            std::fprintf(stderr, "%zu tasks failed\n", failed.load());
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}